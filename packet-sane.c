@@ -26,66 +26,27 @@
 #include <glib.h>
 #include <epan/packet.h>
 #include <epan/prefs.h>
-#include <epan/emem.h>
+#include <epan/wmem/wmem.h>
 #include <epan/conversation.h>
+#include <epan/expert.h>
+#include <epan/tap.h>
+#include <epan/stats_tree.h>
+#include <epan/crc32-tvb.h>
+#include <epan/dissectors/packet-tcp.h>
+
+#include "packet-sane.h"
+#include "sane-session.h"
 
 #define PROTO_TAG_SANE						"SANE"
-#define TCP_PORT_SANE						6566
-
-#define SANE_NET_INIT						0
-#define SANE_NET_GET_DEVICES				1
-#define SANE_NET_OPEN						2
-#define SANE_NET_CLOSE						3
-#define SANE_NET_GET_OPTION_DESCRIPTORS		4
-#define SANE_NET_CONTROL_OPTION				5
-#define SANE_NET_GET_PARAMETERS				6
-#define SANE_NET_START						7
-#define SANE_NET_CANCEL						8
-#define SANE_NET_AUTHORIZE					9
-#define SANE_NET_EXIT						10
-
-#define SANE_STATUS_GOOD					0
-#define SANE_STATUS_UNSUPPORTED				1
-#define SANE_STATUS_CANCELLED				2
-#define SANE_STATUS_DEVICE_BUSY				3
-#define SANE_STATUS_INVAL					4
-#define SANE_STATUS_EOF						5
-#define SANE_STATUS_JAMMED					6
-#define SANE_STATUS_NO_DOCS					7
-#define SANE_STATUS_COVER_OPEN				8
-#define SANE_STATUS_IO_ERROR				9
-#define SANE_STATUS_NO_MEM					10
-#define SANE_STATUS_ACCESS_DENIED			11
-
-#define SANE_TYPE_BOOL						0
-#define SANE_TYPE_INT						1
-#define SANE_TYPE_FIXED						2
-#define SANE_TYPE_STRING					3
-#define SANE_TYPE_BUTTON					4
-#define SANE_TYPE_GROUP						5
-
-#define SANE_UNIT_NONE						0
-#define SANE_UNIT_PIXEL						1
-#define SANE_UNIT_BIT						2
-#define SANE_UNIT_MM						3
-#define SANE_UNIT_DPI						4
-#define SANE_UNIT_PERCENT					5
-#define SANE_UNIT_MICROSECOND				6
-
-#define SANE_CONSTRAINT_NONE				0
-#define SANE_CONSTRAINT_RANGE				1
-#define SANE_CONSTRAINT_WORD_LIST			2
-#define SANE_CONSTRAINT_STRING_LIST			3
-
-#define SANE_ACTION_GET_VALUE				0
-#define SANE_ACTION_SET_VALUE				1
-#define SANE_ACTION_SET_AUTO				2
-
-#define SANE_FRAME_GRAY						0
-#define SANE_FRAME_RGB						1
-#define SANE_FRAME_RED						2
-#define SANE_FRAME_GREEN					3
-#define SANE_FRAME_BLUE						4
+
+#define SANE_PROTO_DATA_PDU					0
+#define SANE_PROTO_DATA_DUPLICATE			1
+#define SANE_PROTO_DATA_PERF				2
+#define SANE_PROTO_DATA_WALK				3
+#define SANE_PROTO_DATA_POSITION			4
+
+/* Option value arrays up to this many elements are always broken down */
+#define SANE_VALUE_EXPAND_LIMIT				16
 
 static const value_string CodeNames[] = {
 	{ SANE_NET_INIT,					"SANE_NET_INIT"						},
@@ -170,9 +131,45 @@ static const value_string FrameNames[] = {
 	{ 0,								NULL								}
 };
 
+static const value_string CompletenessNames[] = {
+	{ SANE_DATA_UNKNOWN,				"Unknown"							},
+	{ SANE_DATA_COMPLETE,				"Complete"							},
+	{ SANE_DATA_SHORT,					"Short"								},
+	{ SANE_DATA_OVERLONG,				"Over-long"							},
+
+	{ 0,								NULL								}
+};
+
 /* Wireshark ID of the SANE protocol */
 static int proto_sane = -1;
 
+/* Wireshark ID of the SANE tap */
+static int sane_tap = -1;
+
+/* Wireshark ID of the SANE performance tap */
+static int sane_perf_tap = -1;
+
+/* Wireshark ID of the SANE traffic tap */
+static int sane_io_tap = -1;
+
+/* Reassemble PDUs spanning multiple TCP segments */
+static gboolean sane_desegment = TRUE;
+
+/* Walk only the record headers of image data connections */
+static gboolean sane_data_headers_only = FALSE;
+
+/* Dissect every Nth record when walking only the headers, 0 for none */
+static guint sane_data_sample_interval = 0;
+
+/* Length of the intervals of the SANE traffic statistics in seconds */
+static guint sane_io_interval = 60;
+
+/* Measure the dissector itself for the SANE performance statistics */
+static gboolean sane_perf_counters = FALSE;
+
+/* Running since registration, only ever read */
+static GTimer *sane_perf_timer = NULL;
+
 /* The following hf_* variables are used to hold the Wireshark IDs of
 * our header fields; they are filled out when we call
 * proto_register_field_array() in proto_register_sane()
@@ -181,6 +178,13 @@ static int proto_sane = -1;
 /** Defining the protocol */
 static gint hf_sane_rpc_code = -1;
 static gint hf_sane_rpc_status = -1;
+static gint hf_sane_response_in = -1;
+static gint hf_sane_response_to = -1;
+static gint hf_sane_srt = -1;
+static gint hf_sane_auth_challenge_in = -1;
+static gint hf_sane_auth_response_in = -1;
+static gint hf_sane_auth_request_in = -1;
+static gint hf_sane_auth_delay = -1;
 static gint hf_sane_net_version_code = -1;
 static gint hf_sane_net_version_code_major = -1;
 static gint hf_sane_net_version_code_minor = -1;
@@ -191,6 +195,7 @@ static gint hf_sane_net_device_name = -1;
 static gint hf_sane_net_device_vendor = -1;
 static gint hf_sane_net_device_model = -1;
 static gint hf_sane_net_device_type = -1;
+static gint hf_sane_net_devices_same_as = -1;
 static gint hf_sane_net_handle = -1;
 static gint hf_sane_net_resource = -1;
 static gint hf_sane_net_username = -1;
@@ -205,6 +210,13 @@ static gint hf_sane_net_option_type = -1;
 static gint hf_sane_net_option_unit = -1;
 static gint hf_sane_net_option_size = -1;
 static gint hf_sane_net_option_cap = -1;
+static gint hf_sane_net_option_cap_soft_select = -1;
+static gint hf_sane_net_option_cap_hard_select = -1;
+static gint hf_sane_net_option_cap_soft_detect = -1;
+static gint hf_sane_net_option_cap_emulated = -1;
+static gint hf_sane_net_option_cap_automatic = -1;
+static gint hf_sane_net_option_cap_inactive = -1;
+static gint hf_sane_net_option_cap_advanced = -1;
 static gint hf_sane_net_option_constraint_type = -1;
 static gint hf_sane_net_option_constraint_range = -1;
 static gint hf_sane_net_option_constraint_range_min = -1;
@@ -219,7 +231,17 @@ static gint hf_sane_net_action = -1;
 static gint hf_sane_net_value_type = -1;
 static gint hf_sane_net_value_size = -1;
 static gint hf_sane_net_value = -1;
+static gint hf_sane_net_value_count = -1;
+static gint hf_sane_net_value_bool = -1;
+static gint hf_sane_net_value_int = -1;
+static gint hf_sane_net_value_fixed = -1;
+static gint hf_sane_net_value_string = -1;
 static gint hf_sane_net_info = -1;
+static gint hf_sane_net_info_inexact = -1;
+static gint hf_sane_net_info_reload_options = -1;
+static gint hf_sane_net_info_reload_params = -1;
+static gint hf_sane_net_value_unchanged_since = -1;
+static gint hf_sane_net_reload_in = -1;
 static gint hf_sane_net_port = -1;
 static gint hf_sane_net_byte_order = -1;
 static gint hf_sane_net_parameters = -1;
@@ -229,731 +251,2331 @@ static gint hf_sane_net_parameters_bytes_per_line = -1;
 static gint hf_sane_net_parameters_pixels_per_line = -1;
 static gint hf_sane_net_parameters_lines = -1;
 static gint hf_sane_net_parameters_depth = -1;
+static gint hf_sane_data_record_length = -1;
+static gint hf_sane_data_record = -1;
+static gint hf_sane_data_status = -1;
+static gint hf_sane_data_start_in = -1;
+static gint hf_sane_data_parameters_in = -1;
+static gint hf_sane_data_image_frame = -1;
+static gint hf_sane_data_bytes_expected = -1;
+static gint hf_sane_data_bytes_received = -1;
+static gint hf_sane_data_lines_received = -1;
+static gint hf_sane_data_completeness = -1;
+static gint hf_sane_data_records = -1;
+static gint hf_sane_data_bytes = -1;
+static gint hf_sane_data_lines = -1;
+static gint hf_sane_duplicate_data = -1;
+static gint hf_sane_job_id = -1;
+static gint hf_sane_job_page = -1;
+static gint hf_sane_job_feed_time = -1;
+static gint hf_sane_job_client_gap = -1;
+static gint hf_sane_job_transfer_time = -1;
+static gint hf_sane_job_pages = -1;
+static gint hf_sane_job_duration = -1;
+static gint hf_sane_job_ppm = -1;
+static gint hf_sane_contention_device = -1;
+static gint hf_sane_contention_holder = -1;
+static gint hf_sane_contention_held_since = -1;
+static gint hf_sane_contention_retries = -1;
+static gint hf_sane_contention_wait = -1;
+static gint hf_sane_contention_hold = -1;
+static gint hf_sane_session = -1;
+static gint hf_sane_session_id = -1;
+static gint hf_sane_session_user_name = -1;
+static gint hf_sane_session_device = -1;
+static gint hf_sane_session_handle = -1;
+static gint hf_sane_session_status = -1;
 
 /* These are the ids of the subtrees that we may be creating */
 static gint ett_sane = -1;
+static gint ett_sane_value = -1;
+
+/* Expert infos */
+static expert_field ei_sane_data_short = EI_INIT;
+static expert_field ei_sane_data_overlong = EI_INIT;
+static expert_field ei_sane_data_truncated = EI_INIT;
+static expert_field ei_sane_net_value_unchanged = EI_INIT;
+static expert_field ei_sane_auth_challenge = EI_INIT;
+static expert_field ei_sane_duplicate = EI_INIT;
+static expert_field ei_sane_device_busy = EI_INIT;
+
+static const int *sane_net_info_fields[] = {
+	&hf_sane_net_info_inexact,
+	&hf_sane_net_info_reload_options,
+	&hf_sane_net_info_reload_params,
+	NULL
+};
+
+static const int *sane_net_option_cap_fields[] = {
+	&hf_sane_net_option_cap_soft_select,
+	&hf_sane_net_option_cap_hard_select,
+	&hf_sane_net_option_cap_soft_detect,
+	&hf_sane_net_option_cap_emulated,
+	&hf_sane_net_option_cap_automatic,
+	&hf_sane_net_option_cap_inactive,
+	&hf_sane_net_option_cap_advanced,
+	NULL
+};
+
+/* Devices and device lists of all servers in the capture, handed to each session when it is created */
+static sane_registry_t *sane_registry = NULL;
+
+/* Handle of the dissector for the image data connections */
+static dissector_handle_t sane_data_handle;
+
+/* Passed to the SANE tap for every complete request and reply */
+typedef struct _sane_tap_info_t {
+	gboolean request;
+	guint32 rpc;
+	gboolean have_status;
+	guint32 status;
+	nstime_t srt;					/* replies only */
+	const gchar *device;			/* NULL if unknown */
+	const gchar *session;			/* NULL if no request was seen */
+	guint32 info;					/* SANE_NET_CONTROL_OPTION replies only */
+	gboolean challenge;				/* reply asking for authorization, the actual reply follows */
+	const sane_transaction_t *transaction;
+	const sane_data_info_t *data_info;	/* end-of-data records only, transaction is NULL */
+} sane_tap_info_t;
+
+/* Counters of the frame being dissected, see get_sane_perf_info() */
+typedef struct _sane_perf_info_t {
+	gdouble start;					/* seconds on sane_perf_timer */
+	guint32 desegment_requests;
+	guint32 reparsed_bytes;			/* walked by get_sane_pdu_len() before asking for more */
+} sane_perf_info_t;
+
+/* Passed to the SANE performance tap for every PDU and every frame */
+typedef struct _sane_perf_tap_info_t {
+	const gchar *pdu;				/* type of the PDU, NULL for the whole frame */
+	gint elapsed;					/* microseconds spent dissecting */
+	guint32 desegment_requests;		/* frames only */
+	guint32 reparsed_bytes;			/* frames only */
+	gsize state_size;				/* frames only: state of the session so far */
+} sane_perf_tap_info_t;
+
+/* Passed to the SANE traffic tap for every reply and every image data record or segment */
+typedef struct _sane_io_tap_info_t {
+	gboolean reply;
+	nstime_t srt;					/* replies only */
+	guint32 bytes;					/* image data only */
+	guint32 kib;					/* KiB boundaries of the transfer the data crossed */
+	guint32 lines;					/* image lines completed by the data */
+} sane_io_tap_info_t;
+
+/* State of a PDU of a control connection, see get_sane_pdu_info() */
+typedef struct _sane_pdu_info_t {
+	struct _sane_pdu_info_t *next;	/* next PDU of the same frame */
+	gint offset;					/* offset from the real beginning of the buffer */
+	sane_transaction_t *transaction;
+} sane_pdu_info_t;
+
+/* Position of get_sane_pdu_len() within a PDU that may not be complete yet */
+typedef struct _sane_pdu_walk_t {
+	tvbuff_t *tvb;
+	guint64 offset;					/* end of the fields walked so far */
+	guint64 available;				/* end of the data received so far */
+	gboolean incomplete;			/* a field ended beyond the data received so far */
+} sane_pdu_walk_t;
+
+
+static gboolean is_sane_request(packet_info *pinfo)
+{
+	return pinfo->match_port == pinfo->destport || TCP_PORT_SANE == pinfo->destport;
+}
+
+static sane_session_t *get_sane_session(packet_info *pinfo)
+{
+	conversation_t *conversation = NULL;
+	sane_session_t *session = NULL;
+
+	conversation = find_or_create_conversation(pinfo);
+	if (conversation) {
+		session = (sane_session_t*) conversation_get_proto_data(conversation, proto_sane);
+		if (!session) {
+			session = sane_session_new(wmem_file_scope(), sane_registry, conversation->index,
+				wmem_strdup_printf(wmem_packet_scope(), "%s:%u - %s:%u",
+					address_to_str(wmem_packet_scope(), &pinfo->src), pinfo->srcport,
+					address_to_str(wmem_packet_scope(), &pinfo->dst), pinfo->destport));
+			conversation_add_proto_data(conversation, proto_sane, session);
+		}
+	}
+
+	return session;
+}
 
+/*
+ * A frame may carry several PDUs, and a PDU spanning several segments is
+ * dissected from the reassembled buffer in the frame that completes it.
+ * The offset from the real beginning of the buffer tells them apart, as the
+ * payload of a frame starts behind the headers of the lower layers while a
+ * reassembled buffer starts at 0.
+ */
+static sane_pdu_info_t *get_sane_pdu_info(packet_info *pinfo, tvbuff_t *tvb, int offset, gboolean create)
+{
+	sane_pdu_info_t *pdu_info = NULL;
+	sane_pdu_info_t *last_pdu_info = NULL;
+	gint raw_offset = tvb_raw_offset(tvb) + offset;
+
+	pdu_info = (sane_pdu_info_t*) p_get_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_PDU);
+	for (; pdu_info; pdu_info = pdu_info->next) {
+		if (pdu_info->offset == raw_offset)
+			return pdu_info;
+		last_pdu_info = pdu_info;
+	}
+
+	if (!create)
+		return NULL;
+
+	pdu_info = wmem_new0(wmem_file_scope(), sane_pdu_info_t);
+	pdu_info->offset = raw_offset;
+	if (last_pdu_info)
+		last_pdu_info->next = pdu_info;
+	else
+		p_add_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_PDU, pdu_info);
+
+	return pdu_info;
+}
+
+/* Counters of the current frame, NULL unless the performance counters are enabled */
+static sane_perf_info_t *get_sane_perf_info(packet_info *pinfo)
+{
+	sane_perf_info_t *perf = NULL;
+
+	if (!sane_perf_counters)
+		return NULL;
+
+	perf = (sane_perf_info_t*) p_get_proto_data(pinfo->pool, pinfo, proto_sane, SANE_PROTO_DATA_PERF);
+	if (!perf) {
+		perf = wmem_new0(pinfo->pool, sane_perf_info_t);
+		perf->start = g_timer_elapsed(sane_perf_timer, NULL);
+		p_add_proto_data(pinfo->pool, pinfo, proto_sane, SANE_PROTO_DATA_PERF, perf);
+	}
+
+	return perf;
+}
+
+static gint get_sane_perf_elapsed(gdouble start)
+{
+	return (gint) ((g_timer_elapsed(sane_perf_timer, NULL) - start) * 1000000);
+}
+
+static void queue_sane_perf_pdu(packet_info *pinfo, const gchar *pdu, gdouble start)
+{
+	sane_perf_tap_info_t *perf_tap_info = NULL;
+
+	perf_tap_info = wmem_new0(wmem_packet_scope(), sane_perf_tap_info_t);
+	perf_tap_info->pdu = pdu;
+	perf_tap_info->elapsed = get_sane_perf_elapsed(start);
+	tap_queue_packet(sane_perf_tap, pinfo, perf_tap_info);
+}
+
+static void queue_sane_perf_frame(packet_info *pinfo, const sane_perf_info_t *perf, gsize state_size)
+{
+	sane_perf_tap_info_t *perf_tap_info = NULL;
+
+	perf_tap_info = wmem_new0(wmem_packet_scope(), sane_perf_tap_info_t);
+	perf_tap_info->elapsed = get_sane_perf_elapsed(perf->start);
+	perf_tap_info->desegment_requests = perf->desegment_requests;
+	perf_tap_info->reparsed_bytes = perf->reparsed_bytes;
+	perf_tap_info->state_size = state_size;
+	tap_queue_packet(sane_perf_tap, pinfo, perf_tap_info);
+}
+
+/* Size of the elements of an option value, see sanei_w_option_value() */
+static guint32 get_sane_value_element_size(guint32 value_type)
+{
+	switch (value_type) {
+		case SANE_TYPE_BOOL:
+		case SANE_TYPE_INT:
+		case SANE_TYPE_FIXED:
+			return 4;
+
+		case SANE_TYPE_STRING:
+			return 1;
+	}
+
+	/* buttons and groups have no value */
+	return 0;
+}
+
+/* Option values of unknown types are not encoded at all, not even their element count */
+static gboolean has_sane_value(guint32 value_type)
+{
+	return value_type <= SANE_TYPE_GROUP;
+}
 
-static gboolean check_remaining_length(packet_info *pinfo, guint initial_offset, guint offset, guint length, int need)
+static gboolean walk_sane_bytes(sane_pdu_walk_t *walk, guint64 len)
 {
-	int have = length - offset;
+	if (walk->incomplete)
+		return FALSE;
 
-	if (need > have) {
-		pinfo->desegment_offset = initial_offset;
-		pinfo->desegment_len = need - have;
+	walk->offset += len;
+	if (walk->offset > walk->available) {
+		walk->incomplete = TRUE;
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
-static guint dissect_sane_rpc_request(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb, guint offset, guint length)
+static gboolean walk_sane_word(sane_pdu_walk_t *walk, guint32 *value)
+{
+	if (!walk_sane_bytes(walk, 4))
+		return FALSE;
+
+	if (value)
+		*value = tvb_get_ntohl(walk->tvb, (gint) walk->offset - 4);
+	return TRUE;
+}
+
+static gboolean walk_sane_string(sane_pdu_walk_t *walk)
+{
+	guint32 len = 0;
+
+	return walk_sane_word(walk, &len) && walk_sane_bytes(walk, len);
+}
+
+static gboolean walk_sane_value(sane_pdu_walk_t *walk, guint32 value_type)
+{
+	guint32 cnt = 0;
+
+	if (!has_sane_value(value_type))
+		return !walk->incomplete;
+
+	return walk_sane_word(walk, &cnt) && walk_sane_bytes(walk, (guint64) cnt * get_sane_value_element_size(value_type));
+}
+
+static gboolean walk_sane_option_descriptor(sane_pdu_walk_t *walk)
+{
+	guint32 constraint_type = 0;
+	guint32 is_null = 0;
+	guint32 cnt = 0;
+	guint32 idx = 0;
+
+	walk_sane_string(walk); /* name */
+	walk_sane_string(walk); /* title */
+	walk_sane_string(walk); /* desc */
+	walk_sane_bytes(walk, 4 * 4); /* type, unit, size and cap */
+	walk_sane_word(walk, &constraint_type);
+
+	switch (constraint_type) {
+		case SANE_CONSTRAINT_RANGE:
+			if (walk_sane_word(walk, &is_null) && !is_null)
+				walk_sane_bytes(walk, 4 * 3);
+		break;
+
+		case SANE_CONSTRAINT_WORD_LIST:
+			if (walk_sane_word(walk, &cnt))
+				walk_sane_bytes(walk, (guint64) cnt * 4);
+		break;
+
+		case SANE_CONSTRAINT_STRING_LIST:
+			walk_sane_word(walk, &cnt);
+			for (idx = 0; idx < cnt && !walk->incomplete; idx++)
+				walk_sane_string(walk);
+		break;
+	}
+
+	return !walk->incomplete;
+}
+
+/*
+ * Length of the PDU at offset, for tcp_dissect_pdus(). Requests start with
+ * their RPC code, replies are matched against the oldest outstanding request.
+ * The fields are walked until the data runs out, which then gives the length
+ * of the PDU up to the first field that is still missing. Reassembly asks for
+ * more until the whole PDU has been walked.
+ */
+static guint get_sane_pdu_len(packet_info *pinfo, tvbuff_t *tvb, int offset)
+{
+	sane_session_t *session = NULL;
+	sane_pdu_info_t *pdu_info = NULL;
+	sane_transaction_t *transaction = NULL;
+	sane_perf_info_t *perf = NULL;
+	sane_pdu_walk_t walk;
+	guint32 rpc = 0;
+	guint32 action = 0;
+	guint32 value_type = 0;
+	guint32 is_null = 0;
+	guint32 cnt = 0;
+	guint32 idx = 0;
+
+	walk.tvb = tvb;
+	walk.offset = offset;
+	walk.available = tvb_length(tvb);
+	walk.incomplete = FALSE;
+
+	session = get_sane_session(pinfo);
+
+	if (is_sane_request(pinfo)) {
+		walk_sane_word(&walk, &rpc);
+
+		switch (rpc) {
+			case SANE_NET_INIT:
+				walk_sane_bytes(&walk, 4); /* version code */
+				walk_sane_string(&walk); /* user name */
+			break;
+
+			case SANE_NET_GET_DEVICES:
+			case SANE_NET_EXIT:
+				/* nothing to do here */
+			break;
+
+			case SANE_NET_OPEN:
+				walk_sane_string(&walk); /* device name */
+			break;
+
+			case SANE_NET_CONTROL_OPTION:
+				walk_sane_bytes(&walk, 4 * 2); /* handle and option */
+				walk_sane_word(&walk, &action);
+
+				/* up to protocol version 2 the value was sent along with SANE_ACTION_SET_AUTO */
+				if (session && session->version >= 3 && action == SANE_ACTION_SET_AUTO)
+					break;
+
+				walk_sane_word(&walk, &value_type);
+				walk_sane_bytes(&walk, 4); /* value size */
+				walk_sane_value(&walk, value_type);
+			break;
+
+			case SANE_NET_AUTHORIZE:
+				walk_sane_string(&walk); /* resource */
+				walk_sane_string(&walk); /* username */
+				walk_sane_string(&walk); /* password */
+			break;
+
+			case SANE_NET_CLOSE:
+			case SANE_NET_GET_OPTION_DESCRIPTORS:
+			case SANE_NET_GET_PARAMETERS:
+			case SANE_NET_START:
+			case SANE_NET_CANCEL:
+				walk_sane_bytes(&walk, 4); /* handle */
+			break;
+
+			default:
+				/* unknown request, take the rest of the segment */
+				return tvb_reported_length_remaining(tvb, offset);
+		}
+	} else {
+		if (!pinfo->fd->flags.visited) {
+			if (session)
+				transaction = sane_session_peek_reply(session);
+		} else {
+			pdu_info = get_sane_pdu_info(pinfo, tvb, offset, FALSE);
+			if (!pdu_info) /* this PDU was completed by a later frame */
+				return tvb_reported_length_remaining(tvb, offset) + 1;
+			transaction = pdu_info->transaction;
+		}
+
+		/* without a request to match there is no telling where the reply ends */
+		if (!transaction)
+			return tvb_reported_length_remaining(tvb, offset);
+
+		switch (transaction->rpc) {
+			case SANE_NET_INIT:
+				walk_sane_bytes(&walk, 4 * 2); /* status and version code */
+			break;
+
+			case SANE_NET_GET_DEVICES:
+				walk_sane_bytes(&walk, 4); /* status */
+				walk_sane_word(&walk, &cnt);
+				for (idx = 0; idx < cnt && !walk.incomplete; idx++) {
+					if (!walk_sane_word(&walk, &is_null) || is_null)
+						continue;
+					walk_sane_string(&walk); /* name */
+					walk_sane_string(&walk); /* vendor */
+					walk_sane_string(&walk); /* model */
+					walk_sane_string(&walk); /* type */
+				}
+			break;
+
+			case SANE_NET_OPEN:
+				walk_sane_bytes(&walk, 4 * 2); /* status and handle */
+				walk_sane_string(&walk); /* resource */
+			break;
+
+			case SANE_NET_GET_OPTION_DESCRIPTORS:
+				walk_sane_word(&walk, &cnt);
+				for (idx = 0; idx < cnt && !walk.incomplete; idx++) {
+					if (!walk_sane_word(&walk, &is_null) || is_null)
+						continue;
+					walk_sane_option_descriptor(&walk);
+				}
+			break;
+
+			case SANE_NET_CONTROL_OPTION:
+				walk_sane_bytes(&walk, 4 * 2); /* status and info */
+				walk_sane_word(&walk, &value_type);
+				walk_sane_bytes(&walk, 4); /* value size */
+				walk_sane_value(&walk, value_type);
+				walk_sane_string(&walk); /* resource */
+			break;
+
+			case SANE_NET_GET_PARAMETERS:
+				walk_sane_bytes(&walk, 4 + (4 * 6)); /* status and parameters */
+			break;
+
+			case SANE_NET_START:
+				walk_sane_bytes(&walk, 4 * 3); /* status, port and byte order */
+				walk_sane_string(&walk); /* resource */
+			break;
+
+			case SANE_NET_CLOSE:
+			case SANE_NET_CANCEL:
+			case SANE_NET_AUTHORIZE:
+				walk_sane_bytes(&walk, 4); /* dummy */
+			break;
+
+			default:
+				return tvb_reported_length_remaining(tvb, offset);
+		}
+	}
+
+	/* everything walked so far is walked again once more data arrived */
+	perf = get_sane_perf_info(pinfo);
+	if (perf && sane_desegment && walk.incomplete) {
+		perf->desegment_requests++;
+		perf->reparsed_bytes += (guint32) (walk.available - offset);
+	}
+
+	return (guint) MIN(walk.offset - offset, G_MAXINT32);
+}
+
+static int dissect_sane_string(tvbuff_t *tvb, proto_tree *tree, int hf, int offset)
+{
+	gint len = (gint) tvb_get_ntohl(tvb, offset);
+
+	offset += 4;
+	tvb_ensure_bytes_exist(tvb, offset, len);
+	proto_tree_add_item(tree, hf, tvb, offset, len, ENC_UTF_8);
+
+	return offset + len;
+}
+
+/* Whether the string at offset is neither NULL nor empty */
+static gboolean has_sane_string(tvbuff_t *tvb, int offset)
+{
+	return tvb_get_ntohl(tvb, offset) > 1 || (tvb_get_ntohl(tvb, offset) == 1 && tvb_get_guint8(tvb, offset + 4));
+}
+
+/*
+ * The elements of a word valued option, like gamma or calibration tables.
+ * The value item shows count, range and checksum, while the elements of
+ * big tables are only added when their subtree is open or filtered on.
+ */
+static void dissect_sane_value_words(tvbuff_t *tvb, proto_item *value_item, int offset, guint32 value_type, guint32 cnt)
+{
+	proto_tree *value_tree = NULL;
+	const guint8 *words = NULL;
+	gint32 word = 0;
+	gint32 min = 0;
+	gint32 max = 0;
+	guint32 set = 0;
+	guint32 idx = 0;
+	int hf = 0;
+
+	switch (value_type) {
+		case SANE_TYPE_BOOL:
+			hf = hf_sane_net_value_bool;
+		break;
+
+		case SANE_TYPE_INT:
+			hf = hf_sane_net_value_int;
+		break;
+
+		case SANE_TYPE_FIXED:
+			hf = hf_sane_net_value_fixed;
+		break;
+
+		default:
+			return;
+	}
+
+	if (!value_item || !cnt)
+		return;
+
+	words = tvb_get_ptr(tvb, offset, cnt * 4);
+	min = max = (gint32) (((guint32) words[0] << 24) | ((guint32) words[1] << 16) | ((guint32) words[2] << 8) | words[3]);
+	for (idx = 0; idx < cnt; idx++, words += 4) {
+		word = (gint32) (((guint32) words[0] << 24) | ((guint32) words[1] << 16) | ((guint32) words[2] << 8) | words[3]);
+		min = MIN(min, word);
+		max = MAX(max, word);
+		if (word)
+			set++;
+	}
+
+	switch (value_type) {
+		case SANE_TYPE_BOOL:
+			proto_item_append_text(value_item, " (%u elements, %u true)", cnt, set);
+		break;
+
+		case SANE_TYPE_INT:
+			proto_item_append_text(value_item, " (%u elements, min %d, max %d, CRC-32 0x%08x)", cnt, min, max,
+				crc32_ccitt_tvb_offset(tvb, offset, cnt * 4));
+		break;
+
+		case SANE_TYPE_FIXED:
+			proto_item_append_text(value_item, " (%u elements, min %g, max %g, CRC-32 0x%08x)", cnt,
+				min / 65536.0, max / 65536.0, crc32_ccitt_tvb_offset(tvb, offset, cnt * 4));
+		break;
+	}
+
+	value_tree = proto_item_add_subtree(value_item, ett_sane_value);
+	if (cnt > SANE_VALUE_EXPAND_LIMIT && !tree_expanded(ett_sane_value) && !proto_field_is_referenced(value_tree, hf))
+		return;
+
+	for (idx = 0; idx < cnt; idx++, offset += 4) {
+		if (value_type == SANE_TYPE_FIXED)
+			proto_tree_add_double(value_tree, hf, tvb, offset, 4, (gint32) tvb_get_ntohl(tvb, offset) / 65536.0);
+		else
+			proto_tree_add_item(value_tree, hf, tvb, offset, 4, ENC_BIG_ENDIAN);
+	}
+}
+
+static int dissect_sane_value(tvbuff_t *tvb, proto_tree *tree, int offset, guint32 value_type, int *value_offset, gint *value_len)
+{
+	proto_item *value_item = NULL;
+	proto_tree *value_tree = NULL;
+	guint64 len = 0;
+	guint32 cnt = 0;
+
+	*value_offset = offset;
+	*value_len = 0;
+
+	if (!has_sane_value(value_type))
+		return offset;
+
+	cnt = tvb_get_ntohl(tvb, offset);
+	len = (guint64) cnt * get_sane_value_element_size(value_type);
+	if (len > G_MAXINT32)
+		THROW(ReportedBoundsError);
+	proto_tree_add_item(tree, hf_sane_net_value_count, tvb, offset, 4, ENC_BIG_ENDIAN);
+	offset += 4;
+
+	tvb_ensure_bytes_exist(tvb, offset, (gint) len);
+	value_item = proto_tree_add_item(tree, hf_sane_net_value, tvb, offset, (gint) len, ENC_NA);
+
+	if (value_type == SANE_TYPE_STRING && len) {
+		value_tree = proto_item_add_subtree(value_item, ett_sane_value);
+		proto_tree_add_item(value_tree, hf_sane_net_value_string, tvb, offset, (gint) len, ENC_UTF_8);
+	} else
+		dissect_sane_value_words(tvb, value_item, offset, value_type, cnt);
+
+	*value_offset = offset;
+	*value_len = (gint) len;
+
+	return offset + (gint) len;
+}
+
+static void setup_sane_data_conversation(packet_info *pinfo, sane_session_t *session, sane_transaction_t *transaction, guint32 port)
 {
-	guint remember_initial_offset = offset;
 	conversation_t *conversation = NULL;
+	sane_data_info_t *data_info = NULL;
+
+	data_info = sane_session_start_reply(session, transaction, pinfo->fd->num, &pinfo->fd->abs_ts);
+
+	/* the client connects from any port to the port announced by the server */
+	conversation = conversation_new(pinfo->fd->num, &pinfo->src, &pinfo->dst, PT_TCP, port, 0, NO_PORT2);
+	if (conversation) {
+		conversation_add_proto_data(conversation, proto_sane, data_info);
+		conversation_set_dissector(conversation, sane_data_handle);
+	}
+}
+
+/* Pages per minute of a job, 0 if it took no measurable time */
+static gdouble get_sane_job_ppm(const sane_job_t *job)
+{
+	gdouble duration = nstime_to_sec(&job->duration);
+
+	return duration > 0 ? job->pages * 60 / duration : 0;
+}
+
+static void add_sane_job_summary(proto_tree *sane_tree, tvbuff_t *tvb, const sane_job_t *job)
+{
 	proto_item *sane_sub_item = NULL;
-	proto_tree *sane_sub_tree = NULL;
-	GQueue *frame_rpc_queue = NULL;
-	guint *frame_rpc = NULL;
-	guint rpc = 0;
-	guint len = 0;
-
-	if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-		rpc = tvb_get_ntohl(tvb, offset);
-		proto_tree_add_item(sane_tree, hf_sane_rpc_code, tvb, offset, 4, ENC_BIG_ENDIAN);
-		offset += 4;
-	} else
-		return offset;
 
-	switch (rpc) {
-		case SANE_NET_INIT:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-				sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_version_code, tvb, offset, 4, ENC_BIG_ENDIAN);
-				if (sane_sub_item) {
-					sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
-					proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_major, tvb, offset + 0, 1, ENC_BIG_ENDIAN);
-					proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_minor, tvb, offset + 1, 1, ENC_BIG_ENDIAN);
-					proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_build, tvb, offset + 2, 2, ENC_BIG_ENDIAN);
-				}
-				offset += 4;
-			} else
-				return offset;
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_job_id, tvb, 0, 0, job->id);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_job_pages, tvb, 0, 0, job->pages);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	if (!job->have_page_end)
+		return;
+
+	sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_job_duration, tvb, 0, 0, (nstime_t*) &job->duration);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	sane_sub_item = proto_tree_add_double(sane_tree, hf_sane_job_ppm, tvb, 0, 0, get_sane_job_ppm(job));
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+}
+
+static void add_sane_page_summary(proto_tree *sane_tree, tvbuff_t *tvb, const sane_data_info_t *data_info)
+{
+	proto_item *sane_sub_item = NULL;
+
+	if (!data_info->job)
+		return;
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				len = tvb_get_ntohl(tvb, offset);
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_job_id, tvb, 0, 0, data_info->job->id);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_job_page, tvb, 0, 0, data_info->page);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+}
+
+static int get_sane_string(tvbuff_t *tvb, int offset, const gchar **str)
+{
+	gint len = (gint) tvb_get_ntohl(tvb, offset);
+
+	*str = (const gchar*) tvb_get_string_enc(wmem_packet_scope(), tvb, offset + 4, len, ENC_UTF_8);
+
+	return offset + 4 + len;
+}
+
+/*
+ * The devices of the SANE_NET_GET_DEVICES reply at offset. Every client
+ * asks for the list, which rarely changes, so replies are told apart by a
+ * hash of the list and only a list not seen before goes into the inventory.
+ */
+static const sane_device_list_t *get_sane_device_list(packet_info *pinfo, sane_session_t *session, tvbuff_t *tvb, int offset,
+	guint32 cnt)
+{
+	sane_registry_t *registry = session->registry;
+	const gchar *server = address_to_str(registry->scope, &pinfo->src);
+	sane_device_list_t *device_list = NULL;
+	sane_device_t *device = NULL;
+	const gchar *name = NULL;
+	const gchar *vendor = NULL;
+	const gchar *model = NULL;
+	const gchar *type = NULL;
+	gint len = tvb_reported_length_remaining(tvb, offset);
+	guint32 hash = 0;
+	guint32 idx = 0;
+
+	hash = crc32_ccitt_tvb_offset(tvb, offset, len);
+	device_list = sane_device_list_lookup(registry, server, (guint32) len, hash);
+	if (!device_list) {
+		/* every device takes at least its null-pointer word */
+		device_list = sane_device_list_new(registry, server, (guint32) len, hash, pinfo->fd->num, MIN(cnt, (guint32) len / 4));
+
+		for (idx = 0; idx < cnt; idx++) {
+			if (tvb_get_ntohl(tvb, offset)) { /* null-pointer check */
 				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_user_name, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
+				continue;
+			}
+			offset += 4;
+
+			offset = get_sane_string(tvb, offset, &name);
+			offset = get_sane_string(tvb, offset, &vendor);
+			offset = get_sane_string(tvb, offset, &model);
+			offset = get_sane_string(tvb, offset, &type);
+
+			device = sane_device_get(registry, server, name);
+			sane_device_describe(device, registry->scope, vendor, model, type);
+			sane_device_list_add(device_list, device);
+		}
+	}
+
+	for (idx = 0; idx < device_list->count; idx++)
+		sane_device_seen(device_list->devices[idx], pinfo->fd->num);
+
+	return device_list;
+}
+
+static void track_sane_device(packet_info *pinfo, sane_session_t *session, sane_transaction_t *transaction, guint32 status)
+{
+	sane_device_t *device = NULL;
+
+	/* the reply comes from the server, which may have several clients */
+	device = sane_device_get(session->registry, address_to_str(session->registry->scope, &pinfo->src), transaction->device);
+
+	if (status == SANE_STATUS_GOOD)
+		sane_session_device_opened(session, transaction, device, pinfo->fd->num, &pinfo->fd->abs_ts);
+	else
+		sane_session_device_busy(session, transaction, device);
+}
+
+static void add_sane_contention(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb, const sane_contention_t *contention,
+	gboolean busy)
+{
+	proto_item *sane_sub_item = NULL;
+
+	if (!contention)
+		return;
+
+	sane_sub_item = proto_tree_add_string(sane_tree, hf_sane_contention_device, tvb, 0, 0, contention->device->name);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	if (busy) {
+		if (contention->holder) {
+			sane_sub_item = proto_tree_add_string(sane_tree, hf_sane_contention_holder, tvb, 0, 0, contention->holder);
+			PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+			sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_contention_held_since, tvb, 0, 0, contention->hold_frame);
+			PROTO_ITEM_SET_GENERATED(sane_sub_item);
+		}
+		expert_add_info_format(pinfo, sane_sub_item, &ei_sane_device_busy, "Device busy: %s held by %s",
+			contention->device->name, contention->holder ? contention->holder : "a client not in the capture");
+	}
+
+	if (contention->retries) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_contention_retries, tvb, 0, 0, contention->retries);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (contention->have_wait) {
+		sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_contention_wait, tvb, 0, 0, (nstime_t*) &contention->wait);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (contention->have_hold) {
+		sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_contention_hold, tvb, 0, 0, (nstime_t*) &contention->hold);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+}
+
+static void add_sane_data_summary(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb, sane_data_info_t *data_info)
+{
+	proto_item *sane_sub_item = NULL;
+	sane_parameters_t *parameters = &data_info->parameters;
+	guint64 expected = 0;
+
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_start_in, tvb, 0, 0, data_info->start_frame);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	if (data_info->have_parameters) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_parameters_in, tvb, 0, 0, parameters->frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_image_frame, tvb, 0, 0, data_info->image_frame);
+		proto_item_append_text(sane_sub_item, " (%s%s)", val_to_str(parameters->format, FrameNames, "Unknown format %u"),
+			parameters->last_frame ? ", last frame" : "");
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+		if (parameters->lines >= 0) {
+			expected = (guint64) parameters->bytes_per_line * parameters->lines;
+			sane_sub_item = proto_tree_add_uint64(sane_tree, hf_sane_data_bytes_expected, tvb, 0, 0, expected);
+			PROTO_ITEM_SET_GENERATED(sane_sub_item);
+		}
+	}
+
+	sane_sub_item = proto_tree_add_uint64(sane_tree, hf_sane_data_bytes_received, tvb, 0, 0, data_info->bytes_received);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	if (data_info->have_parameters && parameters->bytes_per_line) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_lines_received, tvb, 0, 0,
+			(guint32) (data_info->bytes_received / parameters->bytes_per_line));
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	add_sane_page_summary(sane_tree, tvb, data_info);
+
+	sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_job_transfer_time, tvb, 0, 0, (nstime_t*) &data_info->transfer_time);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_completeness, tvb, 0, 0, data_info->completeness);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	switch (data_info->completeness) {
+		case SANE_DATA_SHORT:
+			if (parameters->lines >= 0)
+				expert_add_info_format(pinfo, sane_sub_item, &ei_sane_data_short,
+					"Short image frame: %" G_GINT64_MODIFIER "u of %" G_GINT64_MODIFIER "u bytes received",
+					data_info->bytes_received, expected);
+			else
+				expert_add_info_format(pinfo, sane_sub_item, &ei_sane_data_short,
+					"Short image frame: %" G_GINT64_MODIFIER "u bytes received is not a multiple of %u bytes per line",
+					data_info->bytes_received, parameters->bytes_per_line);
 		break;
 
-		case SANE_NET_OPEN:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				len = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_device_name, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
+		case SANE_DATA_OVERLONG:
+			expert_add_info_format(pinfo, sane_sub_item, &ei_sane_data_overlong,
+				"Over-long image frame: %" G_GINT64_MODIFIER "u of %" G_GINT64_MODIFIER "u bytes received",
+				data_info->bytes_received, expected);
 		break;
+	}
+}
+
+/*
+ * What is known about the control connection a frame belongs to, added to
+ * every frame so that a single filter finds all frames of a session. The
+ * values are taken from the state of the session as far as it has been
+ * dissected, so the final status is only known once all frames were seen.
+ */
+static void add_sane_session_summary(proto_tree *sane_tree, tvbuff_t *tvb, const sane_session_t *session,
+	const gchar *device, gboolean have_handle, guint32 handle)
+{
+	proto_item *sane_sub_item = NULL;
+	proto_tree *sane_sub_tree = NULL;
+
+	if (!session)
+		return;
+
+	/* fall back to the device the session used last */
+	if (!device && !have_handle) {
+		device = session->device;
+		have_handle = session->have_handle;
+		handle = session->handle;
+	}
+
+	sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_session, tvb, 0, 0, ENC_NA);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
+
+	sane_sub_item = proto_tree_add_uint(sane_sub_tree, hf_sane_session_id, tvb, 0, 0, session->id);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	if (session->user_name) {
+		sane_sub_item = proto_tree_add_string(sane_sub_tree, hf_sane_session_user_name, tvb, 0, 0, session->user_name);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (device) {
+		sane_sub_item = proto_tree_add_string(sane_sub_tree, hf_sane_session_device, tvb, 0, 0, device);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (have_handle) {
+		sane_sub_item = proto_tree_add_uint(sane_sub_tree, hf_sane_session_handle, tvb, 0, 0, handle);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (session->have_status) {
+		sane_sub_item = proto_tree_add_uint(sane_sub_tree, hf_sane_session_status, tvb, 0, 0, session->status);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+}
+
+static void add_sane_transaction_summary(proto_tree *sane_tree, tvbuff_t *tvb, const sane_session_t *session,
+	const sane_transaction_t *transaction)
+{
+	if (transaction)
+		add_sane_session_summary(sane_tree, tvb, session, transaction->device, transaction->have_handle, transaction->handle);
+	else
+		add_sane_session_summary(sane_tree, tvb, session, NULL, FALSE, 0);
+}
+
+static void add_sane_data_session_summary(proto_tree *sane_tree, tvbuff_t *tvb, const sane_data_info_t *data_info)
+{
+	if (data_info)
+		add_sane_session_summary(sane_tree, tvb, data_info->session, data_info->device, TRUE, data_info->handle);
+}
+
+static void dissect_sane_rpc_request(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb)
+{
+	sane_session_t *session = NULL;
+	sane_pdu_info_t *pdu_info = NULL;
+	sane_data_info_t *data_info = NULL;
+	sane_transaction_t *transaction = NULL;
+	sane_tap_info_t *tap_info = NULL;
+	proto_item *sane_sub_item = NULL;
+	proto_tree *sane_sub_tree = NULL;
+	const gchar *device = NULL;
+	const gchar *user_name = NULL;
+	int offset = 0;
+	int value_offset = 0;
+	gint value_len = 0;
+	guint32 version = 0;
+	guint32 handle = 0;
+	guint32 option = 0;
+	guint32 action = 0;
+	guint32 rpc = 0;
+
+	session = get_sane_session(pinfo);
+
+	rpc = tvb_get_ntohl(tvb, offset);
+	proto_tree_add_item(sane_tree, hf_sane_rpc_code, tvb, offset, 4, ENC_BIG_ENDIAN);
+	offset += 4;
+
+	switch (rpc) {
+		case SANE_NET_INIT:
+			version = tvb_get_ntohl(tvb, offset);
+			sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_version_code, tvb, offset, 4, ENC_BIG_ENDIAN);
+			sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_major, tvb, offset + 0, 1, ENC_BIG_ENDIAN);
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_minor, tvb, offset + 1, 1, ENC_BIG_ENDIAN);
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_build, tvb, offset + 2, 2, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			if (!pinfo->fd->flags.visited)
+				user_name = (const gchar*) tvb_get_string_enc(wmem_packet_scope(), tvb, offset + 4, tvb_get_ntohl(tvb, offset), ENC_UTF_8);
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_user_name, offset);
+
+			/* the build number of the version code is the protocol version */
+			if (!pinfo->fd->flags.visited && session)
+				sane_session_init(session, version, user_name);
+		break;
+
+		case SANE_NET_OPEN:
+			if (!pinfo->fd->flags.visited)
+				device = (const gchar*) tvb_get_string_enc(wmem_packet_scope(), tvb, offset + 4, tvb_get_ntohl(tvb, offset), ENC_UTF_8);
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_device_name, offset);
+		break;
+
+		case SANE_NET_CONTROL_OPTION:
+			handle = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_item(sane_tree, hf_sane_net_handle, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			option = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_item(sane_tree, hf_sane_net_option_num, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			action = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_item(sane_tree, hf_sane_net_action, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			/* up to protocol version 2 the value was sent along with SANE_ACTION_SET_AUTO */
+			if (session && session->version >= 3 && action == SANE_ACTION_SET_AUTO)
+				break;
+
+			proto_tree_add_item(sane_tree, hf_sane_net_value_type, tvb, offset, 4, ENC_BIG_ENDIAN);
+			proto_tree_add_item(sane_tree, hf_sane_net_value_size, tvb, offset + 4, 4, ENC_BIG_ENDIAN);
+			offset = dissect_sane_value(tvb, sane_tree, offset + 8, tvb_get_ntohl(tvb, offset), &value_offset, &value_len);
+		break;
+
+		case SANE_NET_AUTHORIZE:
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_resource, offset);
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_username, offset);
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_password, offset);
+		break;
+
+		case SANE_NET_CLOSE:
+		case SANE_NET_GET_OPTION_DESCRIPTORS:
+		case SANE_NET_GET_PARAMETERS:
+		case SANE_NET_START:
+		case SANE_NET_CANCEL:
+			handle = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_item(sane_tree, hf_sane_net_handle, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+		break;
+	}
+
+	pdu_info = get_sane_pdu_info(pinfo, tvb, 0, !pinfo->fd->flags.visited);
+
+	if (!pinfo->fd->flags.visited && session && pdu_info)
+		pdu_info->transaction = sane_session_request(session, pinfo->fd->num, &pinfo->fd->abs_ts,
+			rpc, handle, option, action, device);
+
+	transaction = pdu_info ? pdu_info->transaction : NULL;
+	if (transaction && transaction->rep_frame) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_response_in, tvb, 0, 0, transaction->rep_frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (transaction && transaction->reload_frame) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_net_reload_in, tvb, 0, 0, transaction->reload_frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (transaction && transaction->auth_frame) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_auth_challenge_in, tvb, 0, 0, transaction->auth_frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (transaction && transaction->authorizes) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_auth_request_in, tvb, 0, 0, transaction->authorizes->req_frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (transaction && transaction->job && transaction->job->end_frame == pinfo->fd->num)
+		add_sane_job_summary(sane_tree, tvb, transaction->job);
+
+	if (transaction)
+		add_sane_contention(pinfo, sane_tree, tvb, transaction->contention, FALSE);
+
+	data_info = transaction ? transaction->data_info : NULL;
+	if (data_info) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_start_in, tvb, 0, 0, data_info->start_frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+		expert_add_info_format(pinfo, sane_sub_item, &ei_sane_data_truncated,
+			"Image data transfer ended without end-of-data record after %" G_GINT64_MODIFIER "u bytes",
+			data_info->bytes_received);
+	}
+
+	tap_info = wmem_new0(wmem_packet_scope(), sane_tap_info_t);
+	tap_info->request = TRUE;
+	tap_info->rpc = rpc;
+	tap_info->device = transaction ? transaction->device : NULL;
+	tap_info->session = session ? session->name : NULL;
+	tap_info->transaction = transaction;
+	tap_queue_packet(sane_tap, pinfo, tap_info);
+}
+
+static int dissect_sane_option_descriptor(tvbuff_t *tvb, proto_tree *sane_tree, int offset)
+{
+	proto_item *sane_sub_item = NULL;
+	proto_tree *sane_sub_tree = NULL;
+	proto_item *sane_subsub_item = NULL;
+	proto_tree *sane_subsub_tree = NULL;
+	guint32 constraint_type = 0;
+	guint32 sub_idx = 0;
+	guint32 sub_cnt = 0;
+
+	sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_option, tvb, offset, -1, ENC_NA);
+	sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
+
+	offset = dissect_sane_string(tvb, sane_sub_tree, hf_sane_net_option_name, offset);
+	offset = dissect_sane_string(tvb, sane_sub_tree, hf_sane_net_option_title, offset);
+	offset = dissect_sane_string(tvb, sane_sub_tree, hf_sane_net_option_desc, offset);
+
+	proto_tree_add_item(sane_sub_tree, hf_sane_net_option_type, tvb, offset, 4, ENC_BIG_ENDIAN);
+	offset += 4;
+
+	proto_tree_add_item(sane_sub_tree, hf_sane_net_option_unit, tvb, offset, 4, ENC_BIG_ENDIAN);
+	offset += 4;
+
+	proto_tree_add_item(sane_sub_tree, hf_sane_net_option_size, tvb, offset, 4, ENC_BIG_ENDIAN);
+	offset += 4;
+
+	proto_tree_add_bitmask(sane_sub_tree, tvb, offset, hf_sane_net_option_cap, ett_sane, sane_net_option_cap_fields, ENC_BIG_ENDIAN);
+	offset += 4;
+
+	constraint_type = tvb_get_ntohl(tvb, offset);
+	proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_type, tvb, offset, 4, ENC_BIG_ENDIAN);
+	offset += 4;
+
+	switch (constraint_type) {
+		case SANE_CONSTRAINT_NONE:
+			/* nothing to do here */
+		break;
+
+		case SANE_CONSTRAINT_RANGE:
+			if (tvb_get_ntohl(tvb, offset)) { /* null-pointer check */
+				offset += 4;
+				break;
+			}
+			offset += 4;
+
+			sane_subsub_item = proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_range, tvb, offset, 4 * 3, ENC_NA);
+			sane_subsub_tree = proto_item_add_subtree(sane_subsub_item, ett_sane);
+
+			proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_range_min, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_range_max, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_range_quant, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+		break;
+
+		case SANE_CONSTRAINT_WORD_LIST:
+			sub_cnt = tvb_get_ntohl(tvb, offset);
+			sane_subsub_item = proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_word_list, tvb, offset, 4, ENC_BIG_ENDIAN);
+			sane_subsub_tree = proto_item_add_subtree(sane_subsub_item, ett_sane);
+			offset += 4;
+
+			for (sub_idx = 0; sub_idx < sub_cnt; sub_idx++) {
+				proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_word_list_item, tvb, offset, 4, ENC_BIG_ENDIAN);
+				offset += 4;
+			}
+		break;
+
+		case SANE_CONSTRAINT_STRING_LIST:
+			sub_cnt = tvb_get_ntohl(tvb, offset);
+			sane_subsub_item = proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_string_list, tvb, offset, 4, ENC_BIG_ENDIAN);
+			sane_subsub_tree = proto_item_add_subtree(sane_subsub_item, ett_sane);
+			offset += 4;
+
+			for (sub_idx = 0; sub_idx < sub_cnt; sub_idx++)
+				offset = dissect_sane_string(tvb, sane_subsub_tree, hf_sane_net_option_constraint_string_list_item, offset);
+		break;
+	}
+
+	proto_item_set_end(sane_sub_item, tvb, offset);
+
+	return offset;
+}
+
+static void dissect_sane_rpc_response(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb)
+{
+	proto_item *sane_sub_item = NULL;
+	proto_tree *sane_sub_tree = NULL;
+	sane_session_t *session = NULL;
+	sane_pdu_info_t *pdu_info = NULL;
+	sane_transaction_t *packet_rpc = NULL;
+	sane_tap_info_t *tap_info = NULL;
+	sane_io_tap_info_t *io_tap_info = NULL;
+	sane_parameters_t parameters;
+	gboolean have_status = FALSE;
+	gboolean challenge = FALSE;
+	int offset = 0;
+	int resource_offset = 0;
+	int value_offset = 0;
+	gint value_len = 0;
+	guint32 idx = 0;
+	guint32 cnt = 0;
+	guint32 rpc = 0;
+	guint32 status = 0;
+	guint32 port = 0;
+	guint32 info = 0;
+	guint32 handle = 0;
+
+	session = get_sane_session(pinfo);
+
+	pdu_info = get_sane_pdu_info(pinfo, tvb, 0, !pinfo->fd->flags.visited);
+	if (!pdu_info)
+		return;
+
+	/* the oldest outstanding request is the one this reply belongs to */
+	if (!pinfo->fd->flags.visited && session)
+		pdu_info->transaction = sane_session_reply(session, pinfo->fd->num, &pinfo->fd->abs_ts);
+
+	packet_rpc = pdu_info->transaction;
+	if (!packet_rpc)
+		return;
+
+	rpc = packet_rpc->rpc;
+
+	col_append_str(pinfo->cinfo, COL_INFO, val_to_str(rpc, CodeNames, "RPC Code: 0x%08x"));
+
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_rpc_code, tvb, 0, 0, rpc);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	switch (rpc) {
+		case SANE_NET_INIT:
+			status = tvb_get_ntohl(tvb, offset);
+			have_status = TRUE;
+			proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_version_code, tvb, offset, 4, ENC_BIG_ENDIAN);
+			sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_major, tvb, offset + 0, 1, ENC_BIG_ENDIAN);
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_minor, tvb, offset + 1, 1, ENC_BIG_ENDIAN);
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_build, tvb, offset + 2, 2, ENC_BIG_ENDIAN);
+			offset += 4;
+		break;
+
+		case SANE_NET_GET_DEVICES:
+			status = tvb_get_ntohl(tvb, offset);
+			have_status = TRUE;
+			proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			cnt = tvb_get_ntohl(tvb, offset);
+			offset += 4;
+
+			if (!pinfo->fd->flags.visited && session && status == SANE_STATUS_GOOD)
+				packet_rpc->device_list = get_sane_device_list(pinfo, session, tvb, offset, cnt);
+
+			if (packet_rpc->device_list && packet_rpc->device_list->frame != pinfo->fd->num) {
+				sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_net_devices_same_as, tvb, 0, 0, packet_rpc->device_list->frame);
+				PROTO_ITEM_SET_GENERATED(sane_sub_item);
+			}
+
+			/* the inventory has the devices, the list is only walked again for the details */
+			for (idx = 0; idx < cnt && sane_tree; idx++) {
+				if (tvb_get_ntohl(tvb, offset)) { /* null-pointer check */
+					offset += 4;
+					continue;
+				}
+				offset += 4;
+
+				sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_device, tvb, offset, -1, ENC_NA);
+				sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
+
+				offset = dissect_sane_string(tvb, sane_sub_tree, hf_sane_net_device_name, offset);
+				offset = dissect_sane_string(tvb, sane_sub_tree, hf_sane_net_device_vendor, offset);
+				offset = dissect_sane_string(tvb, sane_sub_tree, hf_sane_net_device_model, offset);
+				offset = dissect_sane_string(tvb, sane_sub_tree, hf_sane_net_device_type, offset);
+
+				proto_item_set_end(sane_sub_item, tvb, offset);
+			}
+		break;
+
+		case SANE_NET_OPEN:
+			status = tvb_get_ntohl(tvb, offset);
+			have_status = TRUE;
+			proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			handle = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_item(sane_tree, hf_sane_net_handle, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			resource_offset = offset;
+			challenge = has_sane_string(tvb, offset);
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_resource, offset);
+
+			if (!pinfo->fd->flags.visited && session && status == SANE_STATUS_GOOD && !challenge)
+				sane_session_open_reply(session, packet_rpc, handle);
+
+			if (!pinfo->fd->flags.visited && session && packet_rpc->device && !challenge &&
+				(status == SANE_STATUS_GOOD || status == SANE_STATUS_DEVICE_BUSY))
+				track_sane_device(pinfo, session, packet_rpc, status);
+
+			if (!challenge)
+				add_sane_contention(pinfo, sane_tree, tvb, packet_rpc->contention, status == SANE_STATUS_DEVICE_BUSY);
+		break;
+
+		case SANE_NET_GET_OPTION_DESCRIPTORS:
+			cnt = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_item(sane_tree, hf_sane_net_num_options, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			for (idx = 0; idx < cnt; idx++) {
+				if (tvb_get_ntohl(tvb, offset)) { /* null-pointer check */
+					offset += 4;
+					continue;
+				}
+				offset += 4;
+
+				offset = dissect_sane_option_descriptor(tvb, sane_tree, offset);
+			}
+		break;
+
+		case SANE_NET_CONTROL_OPTION:
+			status = tvb_get_ntohl(tvb, offset);
+			have_status = TRUE;
+			proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			info = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_bitmask(sane_tree, tvb, offset, hf_sane_net_info, ett_sane, sane_net_info_fields, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_tree, hf_sane_net_value_type, tvb, offset, 4, ENC_BIG_ENDIAN);
+			proto_tree_add_item(sane_tree, hf_sane_net_value_size, tvb, offset + 4, 4, ENC_BIG_ENDIAN);
+			offset = dissect_sane_value(tvb, sane_tree, offset + 8, tvb_get_ntohl(tvb, offset), &value_offset, &value_len);
+
+			resource_offset = offset;
+			challenge = has_sane_string(tvb, offset);
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_resource, offset);
+
+			if (!pinfo->fd->flags.visited && session && status == SANE_STATUS_GOOD && !challenge)
+				sane_session_control_option_reply(session, packet_rpc, pinfo->fd->num, info, value_len,
+					crc32_ccitt_tvb_offset(tvb, value_offset, value_len));
+
+			if (packet_rpc->unchanged_since) {
+				sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_net_value_unchanged_since, tvb, 0, 0, packet_rpc->unchanged_since);
+				PROTO_ITEM_SET_GENERATED(sane_sub_item);
+				expert_add_info_format(pinfo, sane_sub_item, &ei_sane_net_value_unchanged,
+					"Redundant SANE_ACTION_GET_VALUE: option %u unchanged since frame %u",
+					packet_rpc->option, packet_rpc->unchanged_since);
+			}
+		break;
+
+		case SANE_NET_GET_PARAMETERS:
+			status = tvb_get_ntohl(tvb, offset);
+			have_status = TRUE;
+			proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			if (!pinfo->fd->flags.visited && session && status == SANE_STATUS_GOOD) {
+				parameters.frame = pinfo->fd->num;
+				parameters.format = tvb_get_ntohl(tvb, offset + 0);
+				parameters.last_frame = tvb_get_ntohl(tvb, offset + 4) ? TRUE : FALSE;
+				parameters.bytes_per_line = tvb_get_ntohl(tvb, offset + 8);
+				parameters.pixels_per_line = tvb_get_ntohl(tvb, offset + 12);
+				parameters.lines = (gint32) tvb_get_ntohl(tvb, offset + 16);
+				parameters.depth = tvb_get_ntohl(tvb, offset + 20);
+				sane_session_parameters_reply(session, packet_rpc, &parameters);
+			}
+
+			sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_parameters, tvb, offset, 4 * 6, ENC_NA);
+			sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
+
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_format, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_last_frame, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_bytes_per_line, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_pixels_per_line, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_lines, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_depth, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+		break;
+
+		case SANE_NET_START:
+			status = tvb_get_ntohl(tvb, offset);
+			have_status = TRUE;
+			proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			port = tvb_get_ntohl(tvb, offset);
+			proto_tree_add_item(sane_tree, hf_sane_net_port, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			proto_tree_add_item(sane_tree, hf_sane_net_byte_order, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+
+			resource_offset = offset;
+			challenge = has_sane_string(tvb, offset);
+			offset = dissect_sane_string(tvb, sane_tree, hf_sane_net_resource, offset);
+
+			if (!pinfo->fd->flags.visited && session && status == SANE_STATUS_GOOD && port && !challenge)
+				setup_sane_data_conversation(pinfo, session, packet_rpc, port);
+
+			/* running out of documents, or any other failure, ends the job */
+			if (!pinfo->fd->flags.visited && packet_rpc->job && !packet_rpc->job->end_frame &&
+				status != SANE_STATUS_GOOD && !challenge)
+				sane_job_end(packet_rpc->job, pinfo->fd->num, status);
+
+			if (packet_rpc->started && packet_rpc->started->job && !challenge) {
+				add_sane_page_summary(sane_tree, tvb, packet_rpc->started);
+
+				sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_job_feed_time, tvb, 0, 0, &packet_rpc->started->feed_time);
+				PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+				if (packet_rpc->started->have_client_gap) {
+					sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_job_client_gap, tvb, 0, 0, &packet_rpc->started->client_gap);
+					PROTO_ITEM_SET_GENERATED(sane_sub_item);
+				}
+			} else if (packet_rpc->job && packet_rpc->job->end_frame == pinfo->fd->num) {
+				add_sane_job_summary(sane_tree, tvb, packet_rpc->job);
+			}
+		break;
+
+		case SANE_NET_CLOSE:
+		case SANE_NET_CANCEL:
+		case SANE_NET_AUTHORIZE:
+			proto_tree_add_item(sane_tree, hf_sane_net_dummy, tvb, offset, 4, ENC_BIG_ENDIAN);
+			offset += 4;
+		break;
+	}
+
+	if (!pinfo->fd->flags.visited && session && have_status && !challenge)
+		sane_session_status(session, status);
+
+	/* the actual reply follows once the client has authorized */
+	if (challenge) {
+		if (!pinfo->fd->flags.visited && session)
+			sane_session_authorization_reply(session, packet_rpc, pinfo->fd->num, &pinfo->fd->abs_ts);
+		col_append_str(pinfo->cinfo, COL_INFO, " (authorization requested)");
+	}
+
+	tap_info = wmem_new0(wmem_packet_scope(), sane_tap_info_t);
+	tap_info->request = FALSE;
+	tap_info->rpc = rpc;
+	tap_info->have_status = have_status && !challenge;
+	tap_info->status = status;
+	tap_info->device = packet_rpc->device;
+	tap_info->session = session ? session->name : NULL;
+	tap_info->info = info;
+	tap_info->challenge = challenge;
+	tap_info->transaction = packet_rpc;
+	nstime_delta(&tap_info->srt, &pinfo->fd->abs_ts, &packet_rpc->req_time);
+
+	if (!challenge) {
+		io_tap_info = wmem_new0(wmem_packet_scope(), sane_io_tap_info_t);
+		io_tap_info->reply = TRUE;
+		io_tap_info->srt = tap_info->srt;
+		tap_queue_packet(sane_io_tap, pinfo, io_tap_info);
+	}
+
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_response_to, tvb, 0, 0, packet_rpc->req_frame);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_srt, tvb, 0, 0, &tap_info->srt);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	if (challenge) {
+		if (packet_rpc->rep_frame) {
+			sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_auth_response_in, tvb, 0, 0, packet_rpc->rep_frame);
+			PROTO_ITEM_SET_GENERATED(sane_sub_item);
+		}
+		expert_add_info_format(pinfo, sane_sub_item, &ei_sane_auth_challenge,
+			"%s needs authorization for %s", val_to_str(rpc, CodeNames, "RPC Code: 0x%08x"),
+			tvb_get_string_enc(wmem_packet_scope(), tvb, resource_offset + 4, tvb_get_ntohl(tvb, resource_offset), ENC_UTF_8));
+	} else if (packet_rpc->auth_frame) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_auth_challenge_in, tvb, 0, 0, packet_rpc->auth_frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+		sane_sub_item = proto_tree_add_time(sane_tree, hf_sane_auth_delay, tvb, 0, 0, &packet_rpc->auth_delay);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	if (packet_rpc->authorizes) {
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_auth_request_in, tvb, 0, 0, packet_rpc->authorizes->req_frame);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	tap_queue_packet(sane_tap, pinfo, tap_info);
+}
+
+static int dissect_sane_pdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+{
+	proto_item *sane_item = NULL;
+	proto_tree *sane_tree = NULL;
+	sane_pdu_info_t *pdu_info = NULL;
+	sane_perf_info_t *perf = get_sane_perf_info(pinfo);
+	gdouble start = perf ? g_timer_elapsed(sane_perf_timer, NULL) : 0;
+	gboolean request = is_sane_request(pinfo);
+
+	col_set_str(pinfo->cinfo, COL_PROTOCOL, PROTO_TAG_SANE);
+
+	col_clear(pinfo->cinfo, COL_INFO);
+	col_add_fstr(pinfo->cinfo, COL_INFO, "%d > %d - %s %s",
+		pinfo->srcport,
+		pinfo->destport,
+		request ? "Request" : "Response",
+		request ? val_to_str(tvb_get_ntohl(tvb, 0), CodeNames, "RPC Code: 0x%08x") : ""
+	);
+
+	if (tree) { /* we are being asked for details */
+		sane_item = proto_tree_add_item(tree, proto_sane, tvb, 0, -1, FALSE);
+		sane_tree = proto_item_add_subtree(sane_item, ett_sane);
+	}
+
+	if (request)
+		dissect_sane_rpc_request(pinfo, sane_tree, tvb);
+	else
+		dissect_sane_rpc_response(pinfo, sane_tree, tvb);
+
+	pdu_info = get_sane_pdu_info(pinfo, tvb, 0, FALSE);
+	add_sane_transaction_summary(sane_tree, tvb, get_sane_session(pinfo), pdu_info ? pdu_info->transaction : NULL);
+
+	if (perf)
+		queue_sane_perf_pdu(pinfo, pdu_info && pdu_info->transaction ?
+			val_to_str(pdu_info->transaction->rpc, CodeNames, "Unknown RPC %u") : "Unmatched PDU", start);
+
+	return tvb_length(tvb);
+}
+
+/*
+ * Bytes at the start of a segment that only repeat payload dissected
+ * before, like a TCP retransmission. That payload must not touch the state
+ * of the conversation again. Decided on the first pass and remembered for
+ * the frame. Always 0 for a reassembled buffer, whose offsets have nothing
+ * to do with the sequence numbers of the segment completing it.
+ */
+static guint32 get_sane_seen_len(packet_info *pinfo, sane_seq_t *seq, const struct tcpinfo *tcpinfo)
+{
+	guint32 seen = 0;
+
+	if (pinfo->fd->flags.visited)
+		return GPOINTER_TO_UINT(p_get_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_DUPLICATE));
+
+	if (!seq || !tcpinfo)
+		return 0;
+
+	seen = sane_seq_seen(seq, pinfo->fd->num, tcpinfo->seq, tcpinfo->nxtseq, tcpinfo->is_reassembled);
+	if (seen)
+		p_add_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_DUPLICATE, GUINT_TO_POINTER(seen));
+
+	return seen;
+}
+
+static proto_tree *dissect_sane_duplicate(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+	proto_item *sane_item = NULL;
+	proto_tree *sane_tree = NULL;
+
+	col_set_str(pinfo->cinfo, COL_PROTOCOL, PROTO_TAG_SANE);
+
+	col_clear(pinfo->cinfo, COL_INFO);
+	col_add_fstr(pinfo->cinfo, COL_INFO, "%d > %d - Retransmission",
+		pinfo->srcport,
+		pinfo->destport
+	);
+
+	if (tree) { /* we are being asked for details */
+		sane_item = proto_tree_add_item(tree, proto_sane, tvb, 0, -1, FALSE);
+		sane_tree = proto_item_add_subtree(sane_item, ett_sane);
+	}
+
+	sane_item = proto_tree_add_item(sane_tree, hf_sane_duplicate_data, tvb, 0, -1, ENC_NA);
+	expert_add_info(pinfo, sane_item, &ei_sane_duplicate);
+
+	return sane_tree;
+}
+
+/*
+ * Adds the start of a segment that repeats payload dissected before, and
+ * returns the new payload following it. A PDU the new payload leaves
+ * incomplete has to be asked for relative to the whole segment.
+ */
+static tvbuff_t *dissect_sane_repeated(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint32 seen)
+{
+	proto_item *sane_item = NULL;
+	proto_tree *sane_tree = NULL;
+
+	if (tree) { /* we are being asked for details */
+		sane_item = proto_tree_add_item(tree, proto_sane, tvb, 0, seen, FALSE);
+		sane_tree = proto_item_add_subtree(sane_item, ett_sane);
+	}
+
+	sane_item = proto_tree_add_item(sane_tree, hf_sane_duplicate_data, tvb, 0, seen, ENC_NA);
+	expert_add_info(pinfo, sane_item, &ei_sane_duplicate);
+
+	return tvb_new_subset_remaining(tvb, seen);
+}
+
+static int dissect_sane(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+{
+	sane_perf_info_t *perf = get_sane_perf_info(pinfo);
+	sane_session_t *session = get_sane_session(pinfo);
+	proto_tree *sane_tree = NULL;
+	tvbuff_t *next_tvb = NULL;
+	guint32 seen = 0;
+
+	seen = get_sane_seen_len(pinfo, session ? &session->seq[is_sane_request(pinfo) ? 0 : 1] : NULL, (struct tcpinfo*) data);
+	if (seen && seen >= (guint32) tvb_reported_length(tvb)) {
+		sane_tree = dissect_sane_duplicate(tvb, pinfo, tree);
+		add_sane_transaction_summary(sane_tree, tvb, session, NULL);
+	} else {
+		next_tvb = seen ? dissect_sane_repeated(tvb, pinfo, tree, seen) : tvb;
+		tcp_dissect_pdus(next_tvb, pinfo, tree, sane_desegment, 4, get_sane_pdu_len, dissect_sane_pdu, NULL);
+		if (pinfo->desegment_len)
+			pinfo->desegment_offset += seen;
+	}
+
+	if (perf)
+		queue_sane_perf_frame(pinfo, perf, session ? session->state_size : 0);
+
+	return tvb_length(tvb);
+}
+
+/*
+ * Image data of a record, or of a segment when walking only the headers,
+ * at position within the transfer. Generated for IO graphs, and passed
+ * to the SANE traffic tap.
+ */
+static void add_sane_data_throughput(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb, const sane_data_info_t *data_info,
+	guint64 position, guint32 bytes)
+{
+	sane_io_tap_info_t *io_tap_info = NULL;
+	proto_item *sane_sub_item = NULL;
+	guint32 bytes_per_line = 0;
+	guint32 lines = 0;
+
+	sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_bytes, tvb, 0, 0, bytes);
+	PROTO_ITEM_SET_GENERATED(sane_sub_item);
+
+	if (data_info && data_info->have_parameters && data_info->parameters.bytes_per_line) {
+		bytes_per_line = data_info->parameters.bytes_per_line;
+		lines = (guint32) ((position + bytes) / bytes_per_line - position / bytes_per_line);
+
+		sane_sub_item = proto_tree_add_uint(sane_tree, hf_sane_data_lines, tvb, 0, 0, lines);
+		PROTO_ITEM_SET_GENERATED(sane_sub_item);
+	}
+
+	io_tap_info = wmem_new0(wmem_packet_scope(), sane_io_tap_info_t);
+	io_tap_info->bytes = bytes;
+	io_tap_info->kib = (guint32) ((position + bytes) / 1024 - position / 1024);
+	io_tap_info->lines = lines;
+	tap_queue_packet(sane_io_tap, pinfo, io_tap_info);
+}
+
+/*
+ * Position within the transfer of the next record of the frame. The
+ * position the frame started at is remembered with the frame, the running
+ * position of one dissection is kept in the packet pool, as the records of
+ * the frame are dissected in order every time.
+ */
+static guint64 *get_sane_data_position(packet_info *pinfo, const sane_data_info_t *data_info)
+{
+	guint64 *frame_position = NULL;
+	guint64 *position = NULL;
+
+	position = (guint64*) p_get_proto_data(pinfo->pool, pinfo, proto_sane, SANE_PROTO_DATA_POSITION);
+	if (position)
+		return position;
+
+	frame_position = (guint64*) p_get_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_POSITION);
+	if (!frame_position) {
+		frame_position = wmem_new(wmem_file_scope(), guint64);
+		*frame_position = pinfo->fd->flags.visited ? 0 : data_info->bytes_received;
+		p_add_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_POSITION, frame_position);
+	}
+
+	position = wmem_new(pinfo->pool, guint64);
+	*position = *frame_position;
+	p_add_proto_data(pinfo->pool, pinfo, proto_sane, SANE_PROTO_DATA_POSITION, position);
+
+	return position;
+}
+
+/* Summary of a transfer, added to its end-of-data record */
+static void add_sane_data_end(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb, sane_data_info_t *data_info)
+{
+	sane_tap_info_t *tap_info = NULL;
+
+	add_sane_data_summary(pinfo, sane_tree, tvb, data_info);
+
+	tap_info = wmem_new0(wmem_packet_scope(), sane_tap_info_t);
+	tap_info->device = data_info->device;
+	tap_info->session = data_info->session->name;
+	tap_info->data_info = data_info;
+	tap_queue_packet(sane_tap, pinfo, tap_info);
+}
+
+/*
+ * Walks the records of a segment by their length headers only, without
+ * reassembly and without an item per record, which keeps large transfers
+ * about as cheap as plain TCP. Headers split across segments are carried
+ * over in the walk of the data connection, and the walk every frame
+ * started with is remembered for dissecting it again. Returns FALSE for a
+ * frame the first pass did not walk, e.g. after the preference changed,
+ * which is then dissected record by record.
+ */
+static gboolean dissect_sane_data_headers(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, sane_data_info_t *data_info)
+{
+	sane_data_walk_t *frame_walk = NULL;
+	sane_data_walk_t walk;
+	proto_item *sane_item = NULL;
+	proto_tree *sane_tree = NULL;
+	gint length = tvb_reported_length(tvb);
+	gint offset = 0;
+	gint status_offset = -1;
+	guint64 position = 0;
+	guint32 records = 0;
+	guint32 data_bytes = 0;
+	guint32 skip = 0;
+	guint32 len = 0;
+
+	frame_walk = (sane_data_walk_t*) p_get_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_WALK);
+	if (!frame_walk) {
+		if (pinfo->fd->flags.visited)
+			return FALSE;
+		frame_walk = wmem_new(wmem_file_scope(), sane_data_walk_t);
+		*frame_walk = data_info->walk;
+		p_add_proto_data(wmem_file_scope(), pinfo, proto_sane, SANE_PROTO_DATA_WALK, frame_walk);
+	}
+	walk = *frame_walk;
+	position = walk.bytes;
+
+	if (tree) { /* we are being asked for details */
+		sane_item = proto_tree_add_item(tree, proto_sane, tvb, 0, -1, FALSE);
+		sane_tree = proto_item_add_subtree(sane_item, ett_sane);
+	}
+
+	while (offset < length && !walk.ended) {
+		if (walk.remaining) {
+			skip = MIN(walk.remaining, (guint32) (length - offset));
+			if (walk.status_pending) {
+				status_offset = offset;
+				walk.status_pending = FALSE;
+				walk.ended = TRUE;
+				if (!pinfo->fd->flags.visited)
+					sane_session_status(data_info->session, tvb_get_guint8(tvb, offset));
+			} else {
+				data_bytes += skip;
+				walk.bytes += skip;
+			}
+			walk.remaining -= skip;
+			offset += skip;
+			continue;
+		}
+
+		/* the length header, which may be split across segments */
+		while (walk.header_len < 4 && offset < length)
+			walk.header[walk.header_len++] = tvb_get_guint8(tvb, offset++);
+		if (walk.header_len < 4)
+			break;
+		walk.header_len = 0;
+
+		len = ((guint32) walk.header[0] << 24) | ((guint32) walk.header[1] << 16) | ((guint32) walk.header[2] << 8) | walk.header[3];
+		walk.records++;
+		records++;
+
+		/* the end-of-data record is followed by the final status byte */
+		if (len == SANE_DATA_END_OF_RECORDS) {
+			walk.remaining = 1;
+			walk.status_pending = TRUE;
+		} else
+			walk.remaining = len;
+
+		if (!pinfo->fd->flags.visited)
+			sane_data_record(data_info, pinfo->fd->num, &pinfo->fd->abs_ts, len);
+
+		/* the part of a sampled record within this segment */
+		if (sane_data_sample_interval && len != SANE_DATA_END_OF_RECORDS && !(walk.records % sane_data_sample_interval) &&
+			offset >= 4) {
+			proto_tree_add_item(sane_tree, hf_sane_data_record_length, tvb, offset - 4, 4, ENC_BIG_ENDIAN);
+			proto_tree_add_item(sane_tree, hf_sane_data_record, tvb, offset, (gint) MIN(len, (guint32) (length - offset)), ENC_NA);
+		}
+	}
+
+	if (!pinfo->fd->flags.visited)
+		data_info->walk = walk;
+
+	col_set_str(pinfo->cinfo, COL_PROTOCOL, PROTO_TAG_SANE);
+
+	col_clear(pinfo->cinfo, COL_INFO);
+	col_add_fstr(pinfo->cinfo, COL_INFO, "%d > %d - Image Data %u bytes, %u record headers",
+		pinfo->srcport,
+		pinfo->destport,
+		data_bytes,
+		records
+	);
+
+	sane_item = proto_tree_add_uint(sane_tree, hf_sane_data_records, tvb, 0, 0, records);
+	PROTO_ITEM_SET_GENERATED(sane_item);
+
+	add_sane_data_throughput(pinfo, sane_tree, tvb, data_info, position, data_bytes);
+
+	if (status_offset >= 0) {
+		proto_tree_add_item(sane_tree, hf_sane_data_status, tvb, status_offset, 1, ENC_BIG_ENDIAN);
+		col_append_fstr(pinfo->cinfo, COL_INFO, ", End %s",
+			val_to_str(tvb_get_guint8(tvb, status_offset), StatusNames, "Status: 0x%02x"));
+	}
+
+	if (data_info->end_frame == pinfo->fd->num)
+		add_sane_data_end(pinfo, sane_tree, tvb, data_info);
+
+	add_sane_data_session_summary(sane_tree, tvb, data_info);
+
+	return TRUE;
+}
+
+static guint get_sane_data_record_len(packet_info *pinfo, tvbuff_t *tvb, int offset)
+{
+	sane_perf_info_t *perf = NULL;
+	guint32 len = tvb_get_ntohl(tvb, offset);
+
+	/* the end-of-data record is followed by the final status byte */
+	if (len == SANE_DATA_END_OF_RECORDS)
+		len = 1;
+
+	perf = get_sane_perf_info(pinfo);
+	if (perf && sane_desegment && 4 + (guint64) len > (guint64) tvb_length_remaining(tvb, offset))
+		perf->desegment_requests++;
+
+	return 4 + len;
+}
+
+static int dissect_sane_data_record(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+{
+	conversation_t *conversation = NULL;
+	sane_data_info_t *data_info = NULL;
+	proto_item *sane_item = NULL;
+	proto_tree *sane_tree = NULL;
+	sane_perf_info_t *perf = get_sane_perf_info(pinfo);
+	gdouble start = perf ? g_timer_elapsed(sane_perf_timer, NULL) : 0;
+	guint64 *position = NULL;
+	guint32 len = tvb_get_ntohl(tvb, 0);
+
+	conversation = find_conversation(pinfo->fd->num, &pinfo->src, &pinfo->dst, pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+	if (conversation) {
+		data_info = (sane_data_info_t*) conversation_get_proto_data(conversation, proto_sane);
+	}
+
+	/* before the record counts into the transfer */
+	if (data_info && len != SANE_DATA_END_OF_RECORDS)
+		position = get_sane_data_position(pinfo, data_info);
+
+	col_set_str(pinfo->cinfo, COL_PROTOCOL, PROTO_TAG_SANE);
+
+	col_clear(pinfo->cinfo, COL_INFO);
+	if (len == SANE_DATA_END_OF_RECORDS)
+		col_add_fstr(pinfo->cinfo, COL_INFO, "%d > %d - Image Data End %s",
+			pinfo->srcport,
+			pinfo->destport,
+			val_to_str(tvb_get_guint8(tvb, 4), StatusNames, "Status: 0x%02x")
+		);
+	else
+		col_add_fstr(pinfo->cinfo, COL_INFO, "%d > %d - Image Data %u bytes",
+			pinfo->srcport,
+			pinfo->destport,
+			len
+		);
+
+	if (!pinfo->fd->flags.visited && data_info) {
+		sane_data_record(data_info, pinfo->fd->num, &pinfo->fd->abs_ts, len);
+		if (len == SANE_DATA_END_OF_RECORDS)
+			sane_session_status(data_info->session, tvb_get_guint8(tvb, 4));
+	}
 
-		case SANE_NET_CONTROL_OPTION:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 24)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_handle, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	if (tree) { /* we are being asked for details */
+		sane_item = proto_tree_add_item(tree, proto_sane, tvb, 0, -1, FALSE);
+		sane_tree = proto_item_add_subtree(sane_item, ett_sane);
+	}
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 20)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_option_num, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	proto_tree_add_item(sane_tree, hf_sane_data_record_length, tvb, 0, 4, ENC_BIG_ENDIAN);
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 16)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_action, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	if (len == SANE_DATA_END_OF_RECORDS) {
+		proto_tree_add_item(sane_tree, hf_sane_data_status, tvb, 4, 1, ENC_BIG_ENDIAN);
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 12)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_value_type, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+		if (data_info && data_info->end_frame == pinfo->fd->num)
+			add_sane_data_end(pinfo, sane_tree, tvb, data_info);
+	} else {
+		if (len)
+			proto_tree_add_item(sane_tree, hf_sane_data_record, tvb, 4, len, ENC_NA);
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-				len = tvb_get_ntohl(tvb, offset);
-				proto_tree_add_item(sane_tree, hf_sane_net_value_size, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+		add_sane_data_throughput(pinfo, sane_tree, tvb, data_info, position ? *position : 0, len);
+		if (position)
+			*position += len;
+	}
 
-			offset += 4; /* TODO: element_count? */
+	add_sane_data_session_summary(sane_tree, tvb, data_info);
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_value, tvb, offset, len, ENC_NA);
-				offset += len;
-			} else
-				return offset;
-		break;
+	if (perf)
+		queue_sane_perf_pdu(pinfo, "Image Data Record", start);
 
-		case SANE_NET_AUTHORIZE:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 12)) {
-				len = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_resource, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
-			
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-				len = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_username, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
-			
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				len = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_password, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
-		break;
+	return tvb_length(tvb);
+}
 
-		case SANE_NET_CLOSE:
-		case SANE_NET_GET_OPTION_DESCRIPTORS:
-		case SANE_NET_GET_PARAMETERS:
-		case SANE_NET_START:
-		case SANE_NET_CANCEL:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_handle, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
-		break;
+static int dissect_sane_data(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data)
+{
+	conversation_t *conversation = NULL;
+	sane_data_info_t *data_info = NULL;
+	proto_tree *sane_tree = NULL;
+	sane_perf_info_t *perf = get_sane_perf_info(pinfo);
+	tvbuff_t *next_tvb = NULL;
+	guint32 seen = 0;
+
+	conversation = find_conversation(pinfo->fd->num, &pinfo->src, &pinfo->dst, pinfo->ptype, pinfo->srcport, pinfo->destport, 0);
+	if (conversation) {
+		data_info = (sane_data_info_t*) conversation_get_proto_data(conversation, proto_sane);
 	}
 
-	if (!pinfo->fd->flags.visited) {
-		conversation = find_or_create_conversation(pinfo);
-		if (conversation) {
-			frame_rpc_queue = (GQueue*) conversation_get_proto_data(conversation, proto_sane);
-			if (!frame_rpc_queue) {
-				frame_rpc_queue = (GQueue*) se_alloc(sizeof(GQueue));
-				if (frame_rpc_queue) {
-					g_queue_init(frame_rpc_queue);
-					conversation_add_proto_data(conversation, proto_sane, frame_rpc_queue);
-				}
-			}
-			if (frame_rpc_queue) {
-				frame_rpc = (guint*) se_alloc(sizeof(guint));
-				if (frame_rpc) {
-					*frame_rpc = rpc;
-					g_queue_push_tail(frame_rpc_queue, frame_rpc);
-				}
-			}
+	seen = get_sane_seen_len(pinfo, data_info ? &data_info->seq : NULL, (struct tcpinfo*) data);
+	if (seen && seen >= (guint32) tvb_reported_length(tvb)) {
+		sane_tree = dissect_sane_duplicate(tvb, pinfo, tree);
+		add_sane_data_session_summary(sane_tree, tvb, data_info);
+	} else {
+		next_tvb = seen ? dissect_sane_repeated(tvb, pinfo, tree, seen) : tvb;
+		if (!sane_data_headers_only || !data_info || !dissect_sane_data_headers(next_tvb, pinfo, tree, data_info)) {
+			tcp_dissect_pdus(next_tvb, pinfo, tree, sane_desegment, 4, get_sane_data_record_len, dissect_sane_data_record, NULL);
+			if (pinfo->desegment_len)
+				pinfo->desegment_offset += seen;
 		}
 	}
 
-	return offset;
+	if (perf)
+		queue_sane_perf_frame(pinfo, perf, data_info ? data_info->session->state_size : 0);
+
+	return tvb_length(tvb);
 }
 
-static guint dissect_sane_rpc_response(packet_info *pinfo, proto_tree *sane_tree, tvbuff_t *tvb, guint offset, guint length)
+static const gchar *st_str_srt = "SANE Response Time (ms)";
+static const gchar *st_str_srt_range = "Response Time (ms)";
+static int st_node_srt = -1;
+
+static void sane_srt_stats_tree_init(stats_tree *st)
 {
-	guint remember_initial_offset = offset;
-	conversation_t *conversation = NULL;
-	proto_item *sane_subsub_item = NULL;
-	proto_tree *sane_subsub_tree = NULL;
-	proto_item *sane_sub_item = NULL;
-	proto_tree *sane_sub_tree = NULL;
-	GQueue *packet_rpc_queue = NULL;
-	GQueue *frame_rpc_queue = NULL;
-	guint *packet_rpc = NULL;
-	guint *frame_rpc = NULL;
-	guint sub_idx = 0;
-	guint sub_cnt = 0;
+	gint node = 0;
 	guint idx = 0;
-	guint cnt = 0;
-	guint rpc = 0;
-	guint len = 0;
 
-	conversation = find_or_create_conversation(pinfo);
-	if (conversation) {
-		frame_rpc_queue = (GQueue*) conversation_get_proto_data(conversation, proto_sane);
-	}
+	st_node_srt = stats_tree_create_node(st, st_str_srt, 0, TRUE);
 
-	packet_rpc_queue = (GQueue*) p_get_proto_data(pinfo->fd, proto_sane, 0);
-	if (!packet_rpc_queue) {
-		packet_rpc_queue = (GQueue*) se_alloc(sizeof(GQueue));
-		if (packet_rpc_queue) {
-			g_queue_init(packet_rpc_queue);
-			p_add_proto_data(pinfo->fd, proto_sane, 0, packet_rpc_queue);
-		}
+	for (idx = 0; CodeNames[idx].strptr; idx++) {
+		node = stats_tree_create_node(st, CodeNames[idx].strptr, st_node_srt, TRUE);
+		stats_tree_create_range_node(st, st_str_srt_range, node,
+			"0-1", "1-10", "10-100", "100-1000", "1000-10000", "10000-", NULL);
 	}
+}
 
-	if (packet_rpc_queue) {
-		packet_rpc = (guint*) g_queue_peek_head(packet_rpc_queue);
-		if (!packet_rpc) {
-			if (frame_rpc_queue) {
-				frame_rpc = (guint*) g_queue_peek_head(frame_rpc_queue);
-				if (frame_rpc) {
-					g_queue_push_tail(packet_rpc_queue, frame_rpc);
-					packet_rpc = frame_rpc;
-				}
-			}
-		}
-	}
+static int sane_srt_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_tap_info_t *tap_info = (const sane_tap_info_t*) p;
+	gint node = 0;
 
-	if (!packet_rpc)
-		return offset;
+	if (tap_info->request || tap_info->challenge || !tap_info->transaction)
+		return 0;
 
-	rpc = *packet_rpc;
+	tick_stat_node(st, st_str_srt, 0, TRUE);
+	node = tick_stat_node(st, val_to_str(tap_info->rpc, CodeNames, "Unknown RPC %u"), st_node_srt, TRUE);
+	stats_tree_tick_range(st, st_str_srt_range, node, (int) nstime_to_msec(&tap_info->srt));
 
-	switch (rpc) {
-		case SANE_NET_INIT:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-				proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_version_code, tvb, offset, 4, ENC_BIG_ENDIAN);
-				if (sane_sub_item) {
-					sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
-					proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_major, tvb, offset + 0, 1, ENC_BIG_ENDIAN);
-					proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_minor, tvb, offset + 1, 1, ENC_BIG_ENDIAN);
-					proto_tree_add_item(sane_sub_tree, hf_sane_net_version_code_build, tvb, offset + 2, 2, ENC_BIG_ENDIAN);
-				}
-				offset += 4;
-			} else
-				return offset;
-		break;
+	return 1;
+}
 
-		case SANE_NET_GET_DEVICES:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-				proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+static const gchar *st_str_status = "SANE Replies by Device";
+static int st_node_status = -1;
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				cnt = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
+static void sane_status_stats_tree_init(stats_tree *st)
+{
+	st_node_status = stats_tree_create_node(st, st_str_status, 0, TRUE);
+}
 
-			for (idx = 0; idx < cnt; idx++) {
-				if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-					len = tvb_get_ntohl(tvb, offset);
-					offset += 4;
-				} else
-					return offset;
+static int sane_status_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_tap_info_t *tap_info = (const sane_tap_info_t*) p;
+	gint device_node = 0;
+	gint rpc_node = 0;
 
-				if (len) /* null-pointer check */
-					continue;
+	if (tap_info->request || !tap_info->have_status)
+		return 0;
 
-				if (!check_remaining_length(pinfo, remember_initial_offset, offset, length, 16))
-					return offset;
+	tick_stat_node(st, st_str_status, 0, TRUE);
+	device_node = tick_stat_node(st, tap_info->device ? tap_info->device : "Unknown device", st_node_status, TRUE);
+	rpc_node = tick_stat_node(st, val_to_str(tap_info->rpc, CodeNames, "Unknown RPC %u"), device_node, TRUE);
+	tick_stat_node(st, val_to_str(tap_info->status, StatusNames, "Unknown status %u"), rpc_node, FALSE);
 
-				sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_device, tvb, offset, -1, ENC_NA);
-				if (sane_sub_item) {
-					sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 16)) {
-						len = tvb_get_ntohl(tvb, offset);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_device_name, tvb, offset, len, ENC_UTF_8);
-						offset += len;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 12)) {
-						len = tvb_get_ntohl(tvb, offset);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_device_vendor, tvb, offset, len, ENC_UTF_8);
-						offset += len;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-						len = tvb_get_ntohl(tvb, offset);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_device_model, tvb, offset, len, ENC_UTF_8);
-						offset += len;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-						len = tvb_get_ntohl(tvb, offset);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_device_type, tvb, offset, len, ENC_UTF_8);
-						offset += len;
-					} else
-						return offset;
-
-					proto_item_set_end(sane_sub_item, tvb, offset);
-				}
-			}
-		break;
+	return 1;
+}
 
-		case SANE_NET_OPEN:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 12)) {
-				proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+static const gchar *st_str_options = "SANE Option Churn by Session";
+static const gchar *st_str_options_rtt = "Cumulative Round-Trip Time (us)";
+static const gchar *st_str_options_redundant = "Redundant GET_VALUE";
+static const gchar *st_str_options_reloads = "Reload-Triggered Descriptor Refetches";
+static int st_node_options = -1;
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_handle, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+static void sane_options_stats_tree_init(stats_tree *st)
+{
+	st_node_options = stats_tree_create_node(st, st_str_options, 0, TRUE);
+}
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				len = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_resource, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
-		break;
+static int sane_options_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_tap_info_t *tap_info = (const sane_tap_info_t*) p;
+	const sane_transaction_t *transaction = tap_info->transaction;
+	gint session_node = 0;
 
-		case SANE_NET_GET_OPTION_DESCRIPTORS:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				cnt = tvb_get_ntohl(tvb, offset);
-				proto_tree_add_item(sane_tree, hf_sane_net_num_options, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	if (!tap_info->session || !transaction)
+		return 0;
 
-			for (idx = 0; idx < cnt; idx++) {
-				if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-					len = tvb_get_ntohl(tvb, offset);
-					offset += 4;
-				} else
-					return offset;
+	if (tap_info->request) {
+		if (tap_info->rpc != SANE_NET_GET_OPTION_DESCRIPTORS || !transaction->reload_frame)
+			return 0;
 
-				if (len) /* null-pointer check */
-					continue;
+		/* add the session node without counting a round trip */
+		session_node = increase_stat_node(st, tap_info->session, st_node_options, TRUE, 0);
+		tick_stat_node(st, st_str_options_reloads, session_node, FALSE);
+		return 1;
+	}
 
-				if (!check_remaining_length(pinfo, remember_initial_offset, offset, length, 32))
-					return offset;
-
-				sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_option, tvb, offset, -1, ENC_NA);
-				if (sane_sub_item) {
-					sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 32)) {
-						len = tvb_get_ntohl(tvb, offset);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_name, tvb, offset, len, ENC_UTF_8);
-						offset += len;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 28)) {
-						len = tvb_get_ntohl(tvb, offset);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_title, tvb, offset, len, ENC_UTF_8);
-						offset += len;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 24)) {
-						len = tvb_get_ntohl(tvb, offset);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_desc, tvb, offset, len, ENC_UTF_8);
-						offset += len;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 20)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_type, tvb, offset, 4, ENC_BIG_ENDIAN);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 16)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_unit, tvb, offset, 4, ENC_BIG_ENDIAN);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 12)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_size, tvb, offset, 4, ENC_BIG_ENDIAN);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_cap, tvb, offset, 4, ENC_BIG_ENDIAN);
-						offset += 4;
-					} else
-						return offset;
-
-					if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-						len = tvb_get_ntohl(tvb, offset);
-						proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_type, tvb, offset, 4, ENC_BIG_ENDIAN);
-						offset += 4;
-					} else
-						return offset;
-
-					switch (len) {
-						case SANE_CONSTRAINT_NONE:
-							/* nothing to do here */
-						break;
-
-						case SANE_CONSTRAINT_RANGE:
-							if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-								len = tvb_get_ntohl(tvb, offset);
-								offset += 4;
-							} else
-								return offset;
-
-							if (len) /* null-pointer check */
-								break;
-
-							if (!check_remaining_length(pinfo, remember_initial_offset, offset, length, 4 * 3))
-								return offset;
-
-							sane_subsub_item = proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_range, tvb, offset, 4 * 3, ENC_NA);
-							if (sane_sub_item) {
-								sane_subsub_tree = proto_item_add_subtree(sane_subsub_item, ett_sane);
-
-								proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_range_min, tvb, offset, 4, ENC_BIG_ENDIAN);
-								offset += 4;
-
-								proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_range_max, tvb, offset, 4, ENC_BIG_ENDIAN);
-								offset += 4;
-
-								proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_range_quant, tvb, offset, 4, ENC_BIG_ENDIAN);
-								offset += 4;
-
-								proto_item_set_end(sane_subsub_item, tvb, offset);
-							}
-						break;
-
-						case SANE_CONSTRAINT_WORD_LIST:
-							if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-								sub_cnt = tvb_get_ntohl(tvb, offset);
-								sane_subsub_item = proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_word_list, tvb, offset, 4, ENC_BIG_ENDIAN);
-								offset += 4;
-							} else
-								return offset;
-
-							if (sane_subsub_item) {
-								sane_subsub_tree = proto_item_add_subtree(sane_subsub_item, ett_sane);
-
-								for (sub_idx = 0; sub_idx < sub_cnt; sub_idx++) {
-									if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-										proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_word_list_item, tvb, offset, 4, ENC_BIG_ENDIAN);
-										offset += 4;
-									} else
-										return offset;
-								}
-							}
-						break;
-
-						case SANE_CONSTRAINT_STRING_LIST:
-							if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-								sub_cnt = tvb_get_ntohl(tvb, offset);
-								sane_subsub_item = proto_tree_add_item(sane_sub_tree, hf_sane_net_option_constraint_string_list, tvb, offset, 4, ENC_BIG_ENDIAN);
-								offset += 4;
-							} else
-								return offset;
-
-							if (sane_sub_item) {
-								sane_subsub_tree = proto_item_add_subtree(sane_subsub_item, ett_sane);
-
-								for (sub_idx = 0; sub_idx < sub_cnt; sub_idx++) {
-									if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-										len = tvb_get_ntohl(tvb, offset);
-										offset += 4;
-									} else
-										return offset;
-
-									if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-										proto_tree_add_item(sane_subsub_tree, hf_sane_net_option_constraint_string_list_item, tvb, offset, len, ENC_UTF_8);
-										offset += len;
-									} else
-										return offset;
-								}
-							}
-						break;
-					}
-
-					proto_item_set_end(sane_sub_item, tvb, offset);
-				}
-			}
-		break;
+	if (tap_info->rpc != SANE_NET_CONTROL_OPTION || tap_info->challenge)
+		return 0;
 
-		case SANE_NET_CONTROL_OPTION:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 24)) {
-				proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	/* the session counts SANE_NET_CONTROL_OPTION round trips */
+	tick_stat_node(st, st_str_options, 0, TRUE);
+	session_node = tick_stat_node(st, tap_info->session, st_node_options, TRUE);
+	tick_stat_node(st, val_to_str(transaction->action, ActionNames, "Unknown action %u"), session_node, FALSE);
+	increase_stat_node(st, st_str_options_rtt, session_node, FALSE,
+		(gint) (tap_info->srt.secs * 1000000 + tap_info->srt.nsecs / 1000));
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 20)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_info, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	if (transaction->unchanged_since)
+		tick_stat_node(st, st_str_options_redundant, session_node, FALSE);
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 16)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_value_type, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	return 1;
+}
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 12)) {
-				len = tvb_get_ntohl(tvb, offset);
-				proto_tree_add_item(sane_tree, hf_sane_net_value_size, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+static const gchar *st_str_auth = "SANE Authorization Delay (ms)";
+static const gchar *st_str_auth_range = "Authorization Delay (ms)";
+static const gchar *st_str_auth_denied = "Access Denied";
+static int st_node_auth = -1;
 
-			offset += 4; /* TODO: element_count? */
+/* the replies saned may hold back until the client has authorized */
+static const guint32 sane_auth_rpcs[] = {
+	SANE_NET_OPEN,
+	SANE_NET_CONTROL_OPTION,
+	SANE_NET_START
+};
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_value, tvb, offset, len, ENC_NA);
-				offset += len;
-			} else
-				return offset;
+static void sane_auth_stats_tree_init(stats_tree *st)
+{
+	gint node = 0;
+	guint idx = 0;
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				len = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_resource, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
-		break;
+	st_node_auth = stats_tree_create_node(st, st_str_auth, 0, TRUE);
 
-		case SANE_NET_GET_PARAMETERS:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4 + (4 * 6))) {
-				proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+	for (idx = 0; idx < array_length(sane_auth_rpcs); idx++) {
+		node = stats_tree_create_node(st, val_to_str_const(sane_auth_rpcs[idx], CodeNames, "Unknown RPC"), st_node_auth, TRUE);
+		stats_tree_create_range_node(st, st_str_auth_range, node,
+			"0-100", "100-1000", "1000-10000", "10000-60000", "60000-", NULL);
+	}
+}
 
-			if (!check_remaining_length(pinfo, remember_initial_offset, offset, length, 4 * 6))
-				return offset;
+static int sane_auth_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_tap_info_t *tap_info = (const sane_tap_info_t*) p;
+	const sane_transaction_t *transaction = tap_info->transaction;
+	gint node = 0;
 
-			sane_sub_item = proto_tree_add_item(sane_tree, hf_sane_net_parameters, tvb, offset, 4 * 6, ENC_NA);
-			if (sane_sub_item) {
-				sane_sub_tree = proto_item_add_subtree(sane_sub_item, ett_sane);
+	/* only actual replies of requests that needed authorization */
+	if (tap_info->request || tap_info->challenge || !transaction || !transaction->auth_frame)
+		return 0;
 
-				proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_format, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
+	tick_stat_node(st, st_str_auth, 0, TRUE);
+	node = tick_stat_node(st, val_to_str(tap_info->rpc, CodeNames, "Unknown RPC %u"), st_node_auth, TRUE);
+	stats_tree_tick_range(st, st_str_auth_range, node, (int) nstime_to_msec(&transaction->auth_delay));
+	if (tap_info->have_status && tap_info->status == SANE_STATUS_ACCESS_DENIED)
+		tick_stat_node(st, st_str_auth_denied, node, FALSE);
 
-				proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_last_frame, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
+	return 1;
+}
 
-				proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_bytes_per_line, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
+static const gchar *st_str_contention = "SANE Device Contention";
+static const gchar *st_str_contention_opened = "Opened";
+static const gchar *st_str_contention_busy = "Busy Replies";
+static const gchar *st_str_contention_busy_rate = "Busy Rate (%)";
+static const gchar *st_str_contention_turned_away = "Clients Turned Away";
+static const gchar *st_str_contention_wait = "Wait Time (ms)";
+static const gchar *st_str_contention_hold = "Hold Time (ms)";
+static const gchar *st_str_contention_holders = "Hold Time by Client (ms)";
+static int st_node_contention = -1;
+
+static void sane_contention_stats_tree_init(stats_tree *st)
+{
+	st_node_contention = stats_tree_create_node(st, st_str_contention, 0, TRUE);
+}
 
-				proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_pixels_per_line, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
+static int sane_contention_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_tap_info_t *tap_info = (const sane_tap_info_t*) p;
+	const sane_contention_t *contention = tap_info->transaction ? tap_info->transaction->contention : NULL;
+	gint device_node = 0;
+	gint holders_node = 0;
+	gint hold = 0;
+
+	if (!contention || tap_info->challenge)
+		return 0;
+
+	/* SANE_NET_CLOSE releasing the device */
+	if (tap_info->request) {
+		if (!contention->have_hold)
+			return 0;
+
+		hold = (gint) nstime_to_msec(&contention->hold);
+		device_node = increase_stat_node(st, contention->device->name, st_node_contention, TRUE, 0);
+		avg_stat_node_add_value(st, st_str_contention_hold, device_node, FALSE, hold);
+		holders_node = increase_stat_node(st, st_str_contention_holders, device_node, TRUE, 0);
+		avg_stat_node_add_value(st, tap_info->session ? tap_info->session : "Unknown client", holders_node, FALSE, hold);
+		return 1;
+	}
 
-				proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_lines, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
+	/* SANE_NET_OPEN replies, the device node counts them */
+	tick_stat_node(st, st_str_contention, 0, TRUE);
+	device_node = tick_stat_node(st, contention->device->name, st_node_contention, TRUE);
 
-				proto_tree_add_item(sane_sub_tree, hf_sane_net_parameters_depth, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
+	if (tap_info->status == SANE_STATUS_DEVICE_BUSY) {
+		tick_stat_node(st, st_str_contention_busy, device_node, FALSE);
+		avg_stat_node_add_value(st, st_str_contention_busy_rate, device_node, FALSE, 100);
+		if (contention->retries == 1)
+			tick_stat_node(st, st_str_contention_turned_away, device_node, FALSE);
+	} else {
+		tick_stat_node(st, st_str_contention_opened, device_node, FALSE);
+		avg_stat_node_add_value(st, st_str_contention_busy_rate, device_node, FALSE, 0);
+		if (contention->have_wait)
+			avg_stat_node_add_value(st, st_str_contention_wait, device_node, FALSE, (gint) nstime_to_msec(&contention->wait));
+	}
 
-				proto_item_set_end(sane_sub_item, tvb, offset);
-			}
-		break;
+	return 1;
+}
 
-		case SANE_NET_START:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 16)) {
-				proto_tree_add_item(sane_tree, hf_sane_rpc_status, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+static const gchar *st_str_inventory = "SANE Device Inventory";
+static const gchar *st_str_inventory_first = "First Seen In Frame";
+static const gchar *st_str_inventory_last = "Last Seen In Frame";
+static const gchar *st_str_inventory_opened = "Opened";
+static int st_node_inventory = -1;
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 12)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_port, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+static void sane_inventory_stats_tree_init(stats_tree *st)
+{
+	st_node_inventory = stats_tree_create_node(st, st_str_inventory, 0, TRUE);
+}
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 8)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_byte_order, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
+/* The node of a device, with the frames it was first and last listed or opened in */
+static gint add_sane_inventory_device(stats_tree *st, packet_info *pinfo, const sane_device_t *device, gboolean listed)
+{
+	gint server_node = 0;
+	gint device_node = 0;
 
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				len = tvb_get_ntohl(tvb, offset);
-				offset += 4;
-			} else
-				return offset;
-
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, len)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_resource, tvb, offset, len, ENC_UTF_8);
-				offset += len;
-			} else
-				return offset;
-		break;
+	server_node = listed ? tick_stat_node(st, device->server, st_node_inventory, TRUE) :
+		increase_stat_node(st, device->server, st_node_inventory, TRUE, 0);
+	device_node = listed ? tick_stat_node(st, device->device, server_node, TRUE) :
+		increase_stat_node(st, device->device, server_node, TRUE, 0);
 
-		case SANE_NET_CLOSE:
-		case SANE_NET_CANCEL:
-		case SANE_NET_AUTHORIZE:
-			if (check_remaining_length(pinfo, remember_initial_offset, offset, length, 4)) {
-				proto_tree_add_item(sane_tree, hf_sane_net_dummy, tvb, offset, 4, ENC_BIG_ENDIAN);
-				offset += 4;
-			} else
-				return offset;
-		break;
-	}
+	set_stat_node(st, st_str_inventory_first, device_node, FALSE, (gint) device->first_seen);
+	set_stat_node(st, st_str_inventory_last, device_node, FALSE, (gint) pinfo->fd->num);
 
-	if (packet_rpc_queue) {
-		packet_rpc = (guint*) g_queue_pop_head(packet_rpc_queue);
-		if (packet_rpc) {
-			g_queue_push_tail(packet_rpc_queue, packet_rpc);
-		}
+	return device_node;
+}
+
+static int sane_inventory_stats_tree_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_tap_info_t *tap_info = (const sane_tap_info_t*) p;
+	const sane_transaction_t *transaction = tap_info->transaction;
+	const sane_device_list_t *device_list = NULL;
+	gint device_node = 0;
+	guint32 idx = 0;
+
+	if (tap_info->request || !transaction)
+		return 0;
+
+	/* a device opened without being listed still belongs to the inventory */
+	if (transaction->rpc == SANE_NET_OPEN) {
+		if (!transaction->contention || !tap_info->have_status || tap_info->status != SANE_STATUS_GOOD)
+			return 0;
+
+		device_node = add_sane_inventory_device(st, pinfo, transaction->contention->device, FALSE);
+		tick_stat_node(st, st_str_inventory_opened, device_node, FALSE);
+		return 1;
 	}
 
-	if (!pinfo->fd->flags.visited && frame_rpc_queue) {
-		frame_rpc = (guint*) g_queue_pop_head(frame_rpc_queue);
+	if (transaction->rpc != SANE_NET_GET_DEVICES || !transaction->device_list)
+		return 0;
+
+	/* the device nodes count the listings, and each description the listings that had it */
+	device_list = transaction->device_list;
+	tick_stat_node(st, st_str_inventory, 0, TRUE);
+	for (idx = 0; idx < device_list->count; idx++) {
+		device_node = add_sane_inventory_device(st, pinfo, device_list->devices[idx], TRUE);
+		tick_stat_node(st, wmem_strdup_printf(wmem_packet_scope(), "%s %s (%s)",
+			device_list->vendors[idx], device_list->models[idx], device_list->types[idx]), device_node, FALSE);
 	}
 
-	return offset;
+	return 1;
 }
 
-static void dissect_sane(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+static const gchar *st_str_adf = "SANE ADF Pages";
+static const gchar *st_str_adf_transfer = "Page Transfer Time (ms)";
+static const gchar *st_str_adf_feed = "Scanner Feed Time (ms)";
+static const gchar *st_str_adf_gap = "Client Gap (ms)";
+static const gchar *st_str_adf_jobs = "Jobs";
+static const gchar *st_str_adf_ppm = "Pages per Minute";
+static const gchar *st_str_adf_devices = "By Device";
+static int st_node_adf = -1;
+static int st_node_adf_devices = -1;
+
+static void sane_adf_stats_tree_init(stats_tree *st)
 {
-	proto_item *sane_item = NULL;
-	proto_tree *sane_tree = NULL;
-	gboolean request = pinfo->match_port == pinfo->destport || TCP_PORT_SANE == pinfo->destport;
-	guint offset = 0;
-	guint length = tvb_length(tvb);
+	st_node_adf = stats_tree_create_node(st, st_str_adf, 0, TRUE);
+	stats_tree_create_range_node(st, st_str_adf_transfer, st_node_adf,
+		"0-1000", "1000-2000", "2000-5000", "5000-10000", "10000-30000", "30000-", NULL);
+	stats_tree_create_range_node(st, st_str_adf_feed, st_node_adf,
+		"0-100", "100-500", "500-1000", "1000-2000", "2000-5000", "5000-", NULL);
+	stats_tree_create_range_node(st, st_str_adf_gap, st_node_adf,
+		"0-100", "100-500", "500-1000", "1000-2000", "2000-5000", "5000-", NULL);
+	stats_tree_create_node(st, st_str_adf_jobs, st_node_adf, TRUE);
+	st_node_adf_devices = stats_tree_create_node(st, st_str_adf_devices, st_node_adf, TRUE);
+}
 
-	if (check_col(pinfo->cinfo, COL_PROTOCOL))
-		col_set_str(pinfo->cinfo, COL_PROTOCOL, PROTO_TAG_SANE);
+static int sane_adf_stats_tree_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_tap_info_t *tap_info = (const sane_tap_info_t*) p;
+	const sane_transaction_t *transaction = tap_info->transaction;
+	const sane_data_info_t *data_info = NULL;
+	const sane_job_t *job = NULL;
+	const gchar *device = tap_info->device ? tap_info->device : "Unknown device";
+	gint device_node = 0;
+	gint ppm = 0;
+
+	/* pages end with their end-of-data record */
+	data_info = tap_info->data_info;
+	if (data_info) {
+		if (!data_info->job)
+			return 0;
+
+		/* the frames of a multi-frame image make up one page */
+		if (data_info->image_frame == 1)
+			tick_stat_node(st, st_str_adf, 0, TRUE);
+		stats_tree_tick_range(st, st_str_adf_transfer, st_node_adf, (int) nstime_to_msec(&data_info->transfer_time));
+		stats_tree_tick_range(st, st_str_adf_feed, st_node_adf, (int) nstime_to_msec(&data_info->feed_time));
+		if (data_info->have_client_gap)
+			stats_tree_tick_range(st, st_str_adf_gap, st_node_adf, (int) nstime_to_msec(&data_info->client_gap));
+
+		device_node = tick_stat_node(st, device, st_node_adf_devices, TRUE);
+		avg_stat_node_add_value(st, st_str_adf_transfer, device_node, FALSE, (gint) nstime_to_msec(&data_info->transfer_time));
+		avg_stat_node_add_value(st, st_str_adf_feed, device_node, FALSE, (gint) nstime_to_msec(&data_info->feed_time));
+		if (data_info->have_client_gap)
+			avg_stat_node_add_value(st, st_str_adf_gap, device_node, FALSE, (gint) nstime_to_msec(&data_info->client_gap));
+		return 1;
+	}
 
-	if (check_col(pinfo->cinfo, COL_INFO)) {
-		col_clear(pinfo->cinfo, COL_INFO);
-		col_add_fstr(pinfo->cinfo, COL_INFO, "%d > %d - %s %s",
-			pinfo->srcport,
-			pinfo->destport,
-			request ? "Request" : "Response",
-			request && length >= 4 ? val_to_str(tvb_get_ntohl(tvb, offset), CodeNames, "RPC Code: 0x%08x") : ""
-		);
+	/* jobs end with a failed SANE_NET_START reply or a SANE_NET_CLOSE request */
+	job = transaction ? transaction->job : NULL;
+	if (!job || job->end_frame != pinfo->fd->num || !job->pages)
+		return 0;
+
+	tick_stat_node(st, st_str_adf_jobs, st_node_adf, FALSE);
+	device_node = increase_stat_node(st, device, st_node_adf_devices, TRUE, 0);
+	tick_stat_node(st, st_str_adf_jobs, device_node, FALSE);
+
+	if (job->have_page_end) {
+		ppm = (gint) (get_sane_job_ppm(job) + 0.5);
+		avg_stat_node_add_value(st, st_str_adf_ppm, st_node_adf, FALSE, ppm);
+		avg_stat_node_add_value(st, st_str_adf_ppm, device_node, FALSE, ppm);
 	}
 
-	if (tree) { /* we are being asked for details */
-		sane_item = proto_tree_add_item(tree, proto_sane, tvb, 0, -1, FALSE);
-		sane_tree = proto_item_add_subtree(sane_item, ett_sane);
+	return 1;
+}
+
+static const gchar *st_str_io = "SANE Traffic by Interval";
+static const gchar *st_str_io_replies = "Replies";
+static const gchar *st_str_io_srt = "Response Time (ms)";
+static const gchar *st_str_io_kib = "Image Data (KiB)";
+static const gchar *st_str_io_lines = "Image Lines";
+static int st_node_io = -1;
+
+static void sane_io_stats_tree_init(stats_tree *st)
+{
+	st_node_io = stats_tree_create_node(st, st_str_io, 0, TRUE);
+}
+
+static int sane_io_stats_tree_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_io_tap_info_t *io_tap_info = (const sane_io_tap_info_t*) p;
+	guint interval = MAX(sane_io_interval, 1);
+	guint bucket = 0;
+	gint interval_node = 0;
+
+	/* the counters are kept per interval, not worked out per frame by a filter */
+	bucket = (guint) (nstime_to_sec(&pinfo->rel_ts) / interval) * interval;
+	tick_stat_node(st, st_str_io, 0, TRUE);
+	interval_node = tick_stat_node(st, wmem_strdup_printf(wmem_packet_scope(), "%u-%u s", bucket, bucket + interval),
+		st_node_io, TRUE);
+
+	if (io_tap_info->reply) {
+		tick_stat_node(st, st_str_io_replies, interval_node, FALSE);
+		avg_stat_node_add_value(st, st_str_io_srt, interval_node, FALSE, (gint) nstime_to_msec(&io_tap_info->srt));
+	} else {
+		/* KiB, as bytes soon overflow the counter of an interval */
+		increase_stat_node(st, st_str_io_kib, interval_node, FALSE, (gint) io_tap_info->kib);
+		increase_stat_node(st, st_str_io_lines, interval_node, FALSE, (gint) io_tap_info->lines);
 	}
 
-	if (request)
-		offset = dissect_sane_rpc_request(pinfo, sane_tree, tvb, offset, length);
-	else
-		offset = dissect_sane_rpc_response(pinfo, sane_tree, tvb, offset, length);
+	return 1;
+}
+
+static const gchar *st_str_perf = "SANE Dissector Performance";
+static const gchar *st_str_perf_frames = "Frames (us per frame)";
+static const gchar *st_str_perf_pdus = "PDUs by Type (us per PDU)";
+static const gchar *st_str_perf_desegment = "Desegmentation Requests";
+static const gchar *st_str_perf_reparsed = "Bytes Re-parsed";
+static const gchar *st_str_perf_state = "Conversation State (bytes)";
+static int st_node_perf = -1;
+static int st_node_perf_pdus = -1;
+
+static void sane_perf_stats_tree_init(stats_tree *st)
+{
+	st_node_perf = stats_tree_create_node(st, st_str_perf, 0, TRUE);
+	stats_tree_create_node(st, st_str_perf_frames, st_node_perf, FALSE);
+	st_node_perf_pdus = stats_tree_create_node(st, st_str_perf_pdus, st_node_perf, TRUE);
+	stats_tree_create_node(st, st_str_perf_desegment, st_node_perf, FALSE);
+	stats_tree_create_node(st, st_str_perf_reparsed, st_node_perf, FALSE);
+	stats_tree_create_node(st, st_str_perf_state, st_node_perf, FALSE);
+}
+
+static int sane_perf_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
+{
+	const sane_perf_tap_info_t *perf_tap_info = (const sane_perf_tap_info_t*) p;
+
+	if (perf_tap_info->pdu) {
+		avg_stat_node_add_value(st, st_str_perf_pdus, st_node_perf, TRUE, perf_tap_info->elapsed);
+		avg_stat_node_add_value(st, perf_tap_info->pdu, st_node_perf_pdus, FALSE, perf_tap_info->elapsed);
+		return 1;
+	}
+
+	tick_stat_node(st, st_str_perf, 0, TRUE);
+	avg_stat_node_add_value(st, st_str_perf_frames, st_node_perf, FALSE, perf_tap_info->elapsed);
+	increase_stat_node(st, st_str_perf_desegment, st_node_perf, FALSE, (gint) perf_tap_info->desegment_requests);
+	increase_stat_node(st, st_str_perf_reparsed, st_node_perf, FALSE, (gint) perf_tap_info->reparsed_bytes);
+
+	/* the maximum is the size of the largest session */
+	if (perf_tap_info->state_size)
+		avg_stat_node_add_value(st, st_str_perf_state, st_node_perf, FALSE, (gint) MIN(perf_tap_info->state_size, G_MAXINT32));
+
+	return 1;
+}
+
+static void sane_init(void)
+{
+	sane_registry = sane_registry_new(wmem_file_scope());
 }
 
 void proto_register_sane(void)
@@ -971,6 +2593,27 @@ void proto_register_sane(void)
 		{ &hf_sane_rpc_status,
 			{ "RPC Status", "sane.rpc.status", FT_UINT32, BASE_DEC, VALS(StatusNames), 0x0, "RPC Status", HFILL }
 		},
+		{ &hf_sane_response_in,
+			{ "Response In", "sane.response_in", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The reply to this request is in this frame", HFILL }
+		},
+		{ &hf_sane_response_to,
+			{ "Response To", "sane.response_to", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "This is a reply to the request in this frame", HFILL }
+		},
+		{ &hf_sane_srt,
+			{ "Response Time", "sane.srt", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time between the request and this reply", HFILL }
+		},
+		{ &hf_sane_auth_challenge_in,
+			{ "Authorization Requested In", "sane.auth.challenge_in", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The reply asking for authorization is in this frame", HFILL }
+		},
+		{ &hf_sane_auth_response_in,
+			{ "Actual Response In", "sane.auth.response_in", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The reply following the authorization is in this frame", HFILL }
+		},
+		{ &hf_sane_auth_request_in,
+			{ "Authorizes Request In", "sane.auth.request_in", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The request waiting for this authorization is in this frame", HFILL }
+		},
+		{ &hf_sane_auth_delay,
+			{ "Authorization Delay", "sane.auth.delay", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time between the reply asking for authorization and the actual reply", HFILL }
+		},
 		{ &hf_sane_net_version_code,
 			{ "Version Code", "sane.net.version_code", FT_UINT32, BASE_HEX, NULL, 0x0, "Version Code", HFILL }
 		},
@@ -1001,6 +2644,9 @@ void proto_register_sane(void)
 		{ &hf_sane_net_device_type,
 			{ "Device Type", "sane.net.device.type", FT_STRING, BASE_NONE, NULL, 0x0, "Device Type", HFILL }
 		},
+		{ &hf_sane_net_devices_same_as,
+			{ "Same Devices As", "sane.net.devices_same_as", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The first reply of the server with the same device list is in this frame", HFILL }
+		},
 		{ &hf_sane_net_handle,
 			{ "Handle", "sane.net.handle", FT_UINT32, BASE_HEX, NULL, 0x0, "Handle", HFILL }
 		},
@@ -1043,6 +2689,27 @@ void proto_register_sane(void)
 		{ &hf_sane_net_option_cap,
 			{ "Capabilities", "sane.net.option.cap", FT_UINT32, BASE_HEX, NULL, 0x0, "Option Capabilities", HFILL }
 		},
+		{ &hf_sane_net_option_cap_soft_select,
+			{ "Soft Select", "sane.net.option.cap.soft_select", FT_BOOLEAN, 32, NULL, SANE_CAP_SOFT_SELECT, "SANE_CAP_SOFT_SELECT", HFILL }
+		},
+		{ &hf_sane_net_option_cap_hard_select,
+			{ "Hard Select", "sane.net.option.cap.hard_select", FT_BOOLEAN, 32, NULL, SANE_CAP_HARD_SELECT, "SANE_CAP_HARD_SELECT", HFILL }
+		},
+		{ &hf_sane_net_option_cap_soft_detect,
+			{ "Soft Detect", "sane.net.option.cap.soft_detect", FT_BOOLEAN, 32, NULL, SANE_CAP_SOFT_DETECT, "SANE_CAP_SOFT_DETECT", HFILL }
+		},
+		{ &hf_sane_net_option_cap_emulated,
+			{ "Emulated", "sane.net.option.cap.emulated", FT_BOOLEAN, 32, NULL, SANE_CAP_EMULATED, "SANE_CAP_EMULATED", HFILL }
+		},
+		{ &hf_sane_net_option_cap_automatic,
+			{ "Automatic", "sane.net.option.cap.automatic", FT_BOOLEAN, 32, NULL, SANE_CAP_AUTOMATIC, "SANE_CAP_AUTOMATIC", HFILL }
+		},
+		{ &hf_sane_net_option_cap_inactive,
+			{ "Inactive", "sane.net.option.cap.inactive", FT_BOOLEAN, 32, NULL, SANE_CAP_INACTIVE, "SANE_CAP_INACTIVE", HFILL }
+		},
+		{ &hf_sane_net_option_cap_advanced,
+			{ "Advanced", "sane.net.option.cap.advanced", FT_BOOLEAN, 32, NULL, SANE_CAP_ADVANCED, "SANE_CAP_ADVANCED", HFILL }
+		},
 		{ &hf_sane_net_option_constraint_type,
 			{ "Constraint Type", "sane.net.option.constraint_type", FT_UINT32, BASE_DEC, VALS(ConstraintNames), 0x0, "Option Capabilities", HFILL }
 		},
@@ -1085,9 +2752,39 @@ void proto_register_sane(void)
 		{ &hf_sane_net_value,
 			{ "Value", "sane.net.value", FT_BYTES, BASE_NONE, NULL, 0x0, "Value", HFILL }
 		},
+		{ &hf_sane_net_value_count,
+			{ "Element Count", "sane.net.value.count", FT_UINT32, BASE_DEC, NULL, 0x0, "Number of elements of the value", HFILL }
+		},
+		{ &hf_sane_net_value_bool,
+			{ "Bool", "sane.net.value.bool", FT_BOOLEAN, BASE_NONE, NULL, 0x0, "Element of a SANE_TYPE_BOOL value", HFILL }
+		},
+		{ &hf_sane_net_value_int,
+			{ "Int", "sane.net.value.int", FT_INT32, BASE_DEC, NULL, 0x0, "Element of a SANE_TYPE_INT value", HFILL }
+		},
+		{ &hf_sane_net_value_fixed,
+			{ "Fixed", "sane.net.value.fixed", FT_DOUBLE, BASE_NONE, NULL, 0x0, "Element of a SANE_TYPE_FIXED value", HFILL }
+		},
+		{ &hf_sane_net_value_string,
+			{ "String", "sane.net.value.string", FT_STRING, BASE_NONE, NULL, 0x0, "SANE_TYPE_STRING value", HFILL }
+		},
 		{ &hf_sane_net_info,
 			{ "Info", "sane.net.info", FT_UINT32, BASE_HEX, NULL, 0x0, "Info", HFILL }
 		},
+		{ &hf_sane_net_info_inexact,
+			{ "Inexact", "sane.net.info.inexact", FT_BOOLEAN, 32, NULL, SANE_INFO_INEXACT, "SANE_INFO_INEXACT", HFILL }
+		},
+		{ &hf_sane_net_info_reload_options,
+			{ "Reload Options", "sane.net.info.reload_options", FT_BOOLEAN, 32, NULL, SANE_INFO_RELOAD_OPTIONS, "SANE_INFO_RELOAD_OPTIONS", HFILL }
+		},
+		{ &hf_sane_net_info_reload_params,
+			{ "Reload Parameters", "sane.net.info.reload_params", FT_BOOLEAN, 32, NULL, SANE_INFO_RELOAD_PARAMS, "SANE_INFO_RELOAD_PARAMS", HFILL }
+		},
+		{ &hf_sane_net_value_unchanged_since,
+			{ "Value Unchanged Since", "sane.net.value_unchanged_since", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The client already got this option value in this frame", HFILL }
+		},
+		{ &hf_sane_net_reload_in,
+			{ "Reload Requested In", "sane.net.reload_in", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The reply asking to reload the option descriptors is in this frame", HFILL }
+		},
 		{ &hf_sane_net_port,
 			{ "Port", "sane.net.port", FT_UINT32, BASE_DEC, NULL, 0x0, "Port", HFILL }
 		},
@@ -1110,21 +2807,183 @@ void proto_register_sane(void)
 			{ "Pixels per Line", "sane.net.parameters.pixels_per_line", FT_UINT32, BASE_DEC, NULL, 0x0, "Pixels per Line", HFILL }
 		},
 		{ &hf_sane_net_parameters_lines,
-			{ "Lines", "sane.net.parameters.lines", FT_UINT32, BASE_DEC, NULL, 0x0, "Lines", HFILL }
+			{ "Lines", "sane.net.parameters.lines", FT_INT32, BASE_DEC, NULL, 0x0, "Lines", HFILL }
 		},
 		{ &hf_sane_net_parameters_depth,
 			{ "Depth", "sane.net.parameters.depth", FT_UINT32, BASE_DEC, NULL, 0x0, "Depth", HFILL }
+		},
+		{ &hf_sane_data_record_length,
+			{ "Record Length", "sane.data.record_length", FT_UINT32, BASE_DEC, NULL, 0x0, "Record Length", HFILL }
+		},
+		{ &hf_sane_data_record,
+			{ "Record", "sane.data.record", FT_BYTES, BASE_NONE, NULL, 0x0, "Record", HFILL }
+		},
+		{ &hf_sane_data_status,
+			{ "Status", "sane.data.status", FT_UINT8, BASE_DEC, VALS(StatusNames), 0x0, "Status", HFILL }
+		},
+		{ &hf_sane_data_start_in,
+			{ "Started In", "sane.data.start_in", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The SANE_NET_START reply announcing this transfer is in this frame", HFILL }
+		},
+		{ &hf_sane_data_parameters_in,
+			{ "Parameters In", "sane.data.parameters_in", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The SANE_NET_GET_PARAMETERS reply describing this transfer is in this frame", HFILL }
+		},
+		{ &hf_sane_data_image_frame,
+			{ "Image Frame", "sane.data.image_frame", FT_UINT32, BASE_DEC, NULL, 0x0, "Position of this transfer within a multi-frame image", HFILL }
+		},
+		{ &hf_sane_data_bytes_expected,
+			{ "Bytes Expected", "sane.data.bytes_expected", FT_UINT64, BASE_DEC, NULL, 0x0, "Bytes per Line times Lines", HFILL }
+		},
+		{ &hf_sane_data_bytes_received,
+			{ "Bytes Received", "sane.data.bytes_received", FT_UINT64, BASE_DEC, NULL, 0x0, "Bytes Received", HFILL }
+		},
+		{ &hf_sane_data_lines_received,
+			{ "Lines Received", "sane.data.lines_received", FT_UINT32, BASE_DEC, NULL, 0x0, "Complete Lines Received", HFILL }
+		},
+		{ &hf_sane_data_completeness,
+			{ "Completeness", "sane.data.completeness", FT_UINT32, BASE_DEC, VALS(CompletenessNames), 0x0, "Completeness", HFILL }
+		},
+		{ &hf_sane_data_records,
+			{ "Record Headers", "sane.data.records", FT_UINT32, BASE_DEC, NULL, 0x0, "Record headers walked in this segment", HFILL }
+		},
+		{ &hf_sane_data_bytes,
+			{ "Image Data Bytes", "sane.data.bytes", FT_UINT32, BASE_DEC, NULL, 0x0, "Image data carried by this record, or this segment when walking only the headers", HFILL }
+		},
+		{ &hf_sane_data_lines,
+			{ "Image Lines", "sane.data.lines", FT_UINT32, BASE_DEC, NULL, 0x0, "Image lines completed by this image data", HFILL }
+		},
+		{ &hf_sane_duplicate_data,
+			{ "Retransmitted Data", "sane.duplicate_data", FT_BYTES, BASE_NONE, NULL, 0x0, "Payload that an earlier segment already carried", HFILL }
+		},
+		{ &hf_sane_job_id,
+			{ "Job", "sane.job.id", FT_UINT32, BASE_DEC, NULL, 0x0, "Number of the job of consecutive SANE_NET_START requests within the session", HFILL }
+		},
+		{ &hf_sane_job_page,
+			{ "Page", "sane.job.page", FT_UINT32, BASE_DEC, NULL, 0x0, "Page of the job, a multi-frame image is one page", HFILL }
+		},
+		{ &hf_sane_job_feed_time,
+			{ "Feed Time", "sane.job.feed_time", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time between the SANE_NET_START request and its reply", HFILL }
+		},
+		{ &hf_sane_job_client_gap,
+			{ "Client Gap", "sane.job.client_gap", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time between the end of the previous page and the SANE_NET_START request", HFILL }
+		},
+		{ &hf_sane_job_transfer_time,
+			{ "Transfer Time", "sane.job.transfer_time", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time between the SANE_NET_START reply and the end-of-data record", HFILL }
+		},
+		{ &hf_sane_job_pages,
+			{ "Pages", "sane.job.pages", FT_UINT32, BASE_DEC, NULL, 0x0, "Pages scanned by the job", HFILL }
+		},
+		{ &hf_sane_job_duration,
+			{ "Job Duration", "sane.job.duration", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time between the first SANE_NET_START request and the end of the last page", HFILL }
+		},
+		{ &hf_sane_job_ppm,
+			{ "Pages per Minute", "sane.job.ppm", FT_DOUBLE, BASE_NONE, NULL, 0x0, "Pages per minute over the duration of the job", HFILL }
+		},
+		{ &hf_sane_contention_device,
+			{ "Shared Device", "sane.contention.device", FT_STRING, BASE_NONE, NULL, 0x0, "Server and name of the device the sessions with the server compete for", HFILL }
+		},
+		{ &hf_sane_contention_holder,
+			{ "Held By", "sane.contention.holder", FT_STRING, BASE_NONE, NULL, 0x0, "Session that has the device open", HFILL }
+		},
+		{ &hf_sane_contention_held_since,
+			{ "Held Since", "sane.contention.held_since", FT_FRAMENUM, BASE_NONE, NULL, 0x0, "The SANE_NET_OPEN reply that gave the holder the device is in this frame", HFILL }
+		},
+		{ &hf_sane_contention_retries,
+			{ "Busy Replies", "sane.contention.retries", FT_UINT32, BASE_DEC, NULL, 0x0, "Busy replies the session got for the device in a row", HFILL }
+		},
+		{ &hf_sane_contention_wait,
+			{ "Wait Time", "sane.contention.wait", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time between the first SANE_NET_OPEN request that got a busy reply and the successful reply", HFILL }
+		},
+		{ &hf_sane_contention_hold,
+			{ "Hold Time", "sane.contention.hold", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, "Time the session had the device open", HFILL }
+		},
+		{ &hf_sane_session,
+			{ "Session", "sane.session", FT_NONE, BASE_NONE, NULL, 0x0, "Control connection this frame belongs to", HFILL }
+		},
+		{ &hf_sane_session_id,
+			{ "Session ID", "sane.session.id", FT_UINT32, BASE_DEC, NULL, 0x0, "Index of the control connection within the capture", HFILL }
+		},
+		{ &hf_sane_session_user_name,
+			{ "User Name", "sane.session.user_name", FT_STRING, BASE_NONE, NULL, 0x0, "User name of the SANE_NET_INIT request", HFILL }
+		},
+		{ &hf_sane_session_device,
+			{ "Device Name", "sane.session.device", FT_STRING, BASE_NONE, NULL, 0x0, "Device the frame refers to, or the device the session used last", HFILL }
+		},
+		{ &hf_sane_session_handle,
+			{ "Handle", "sane.session.handle", FT_UINT32, BASE_HEX, NULL, 0x0, "Handle the frame refers to, or the handle the session used last", HFILL }
+		},
+		{ &hf_sane_session_status,
+			{ "Final Status", "sane.session.status", FT_UINT32, BASE_DEC, VALS(StatusNames), 0x0, "Status of the latest reply or end-of-data record of the session", HFILL }
 		}
 	};
 	static gint *ett[] = {
-		&ett_sane
+		&ett_sane,
+		&ett_sane_value
+	};
+	static ei_register_info ei[] = {
+		{ &ei_sane_data_short,
+			{ "sane.data.short", PI_SEQUENCE, PI_WARN, "Short image frame", EXPFILL }
+		},
+		{ &ei_sane_data_overlong,
+			{ "sane.data.overlong", PI_SEQUENCE, PI_WARN, "Over-long image frame", EXPFILL }
+		},
+		{ &ei_sane_data_truncated,
+			{ "sane.data.truncated", PI_SEQUENCE, PI_WARN, "Image data transfer ended without end-of-data record", EXPFILL }
+		},
+		{ &ei_sane_net_value_unchanged,
+			{ "sane.net.value_unchanged", PI_SEQUENCE, PI_NOTE, "Redundant SANE_ACTION_GET_VALUE", EXPFILL }
+		},
+		{ &ei_sane_auth_challenge,
+			{ "sane.auth.challenge", PI_SEQUENCE, PI_CHAT, "Authorization requested", EXPFILL }
+		},
+		{ &ei_sane_duplicate,
+			{ "sane.duplicate", PI_SEQUENCE, PI_NOTE, "Retransmitted or duplicated SANE data, not dissected again", EXPFILL }
+		},
+		{ &ei_sane_device_busy,
+			{ "sane.contention.busy", PI_SEQUENCE, PI_NOTE, "Device busy", EXPFILL }
+		}
 	};
+	expert_module_t *expert_sane;
+	module_t *sane_module;
 
 	proto_sane = proto_register_protocol("SANE Protocol", PROTO_TAG_SANE, "sane");
 	proto_register_field_array(proto_sane, hf, array_length(hf));
 	proto_register_subtree_array(ett, array_length(ett));
-
-	register_dissector("sane", dissect_sane, proto_sane);
+	expert_sane = expert_register_protocol(proto_sane);
+	expert_register_field_array(expert_sane, ei, array_length(ei));
+
+	sane_module = prefs_register_protocol(proto_sane, NULL);
+	prefs_register_bool_preference(sane_module, "desegment",
+		"Reassemble SANE messages spanning multiple TCP segments",
+		"Whether the SANE dissector should reassemble messages spanning multiple TCP segments."
+		" To use this option, you must also enable \"Allow subdissectors to reassemble TCP streams\" in the TCP protocol settings.",
+		&sane_desegment);
+	prefs_register_bool_preference(sane_module, "data_headers_only",
+		"Walk only the record headers of image data",
+		"Whether the SANE dissector should only follow the record length headers of image data connections,"
+		" without reassembling and dissecting the records. Transfer sizes and completeness are still checked.",
+		&sane_data_headers_only);
+	prefs_register_uint_preference(sane_module, "data_sample_interval",
+		"Dissect every Nth image data record",
+		"When walking only the record headers, dissect the part of every Nth record that is in the segment"
+		" with its header. 0 dissects none.",
+		10, &sane_data_sample_interval);
+	prefs_register_uint_preference(sane_module, "io_interval",
+		"Interval of the traffic statistics (s)",
+		"Length of the intervals Statistics > SANE > Traffic by Interval counts replies, response times and image data in.",
+		10, &sane_io_interval);
+	prefs_register_bool_preference(sane_module, "perf_counters",
+		"Collect dissector performance counters",
+		"Whether the SANE dissector should measure the time it spends per PDU and count desegmentation requests"
+		" and re-parsed bytes for Statistics > SANE > Dissector Performance (tshark -z sane_perf,tree). This slows dissection down a little.",
+		&sane_perf_counters);
+
+	new_register_dissector("sane", dissect_sane, proto_sane);
+	register_init_routine(sane_init);
+
+	sane_tap = register_tap("sane");
+	sane_perf_tap = register_tap("sane_perf");
+	sane_io_tap = register_tap("sane_io");
+	sane_perf_timer = g_timer_new();
 }
 
 void proto_reg_handoff_sane(void)
@@ -1133,7 +2992,26 @@ void proto_reg_handoff_sane(void)
 	static dissector_handle_t sane_handle;
 
 	if (!sane_initialized) {
-		sane_handle = create_dissector_handle(dissect_sane, proto_sane);
+		sane_handle = new_create_dissector_handle(dissect_sane, proto_sane);
+		sane_data_handle = new_create_dissector_handle(dissect_sane_data, proto_sane);
+		stats_tree_register_plugin("sane", "sane_srt", "SANE/Response Time", 0,
+			sane_srt_stats_tree_packet, sane_srt_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane", "sane_status", "SANE/Status by Device", 0,
+			sane_status_stats_tree_packet, sane_status_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane", "sane_options", "SANE/Option Churn", 0,
+			sane_options_stats_tree_packet, sane_options_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane", "sane_auth", "SANE/Authorization Delay", 0,
+			sane_auth_stats_tree_packet, sane_auth_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane", "sane_contention", "SANE/Device Contention", 0,
+			sane_contention_stats_tree_packet, sane_contention_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane", "sane_inventory", "SANE/Device Inventory", 0,
+			sane_inventory_stats_tree_packet, sane_inventory_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane", "sane_adf", "SANE/ADF Pages", 0,
+			sane_adf_stats_tree_packet, sane_adf_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane_io", "sane_io", "SANE/Traffic by Interval", 0,
+			sane_io_stats_tree_packet, sane_io_stats_tree_init, NULL);
+		stats_tree_register_plugin("sane_perf", "sane_perf", "SANE/Dissector Performance", 0,
+			sane_perf_stats_tree_packet, sane_perf_stats_tree_init, NULL);
 		sane_initialized = TRUE;
 	} else {
 		dissector_delete_uint("tcp.port", TCP_PORT_SANE, sane_handle);
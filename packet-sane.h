@@ -0,0 +1,97 @@
+/* packet-sane.h
+ * Constants of the SANE network protocol
+ *
+ * Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __PACKET_SANE_H__
+#define __PACKET_SANE_H__
+
+#define TCP_PORT_SANE						6566
+
+#define SANE_NET_INIT						0
+#define SANE_NET_GET_DEVICES				1
+#define SANE_NET_OPEN						2
+#define SANE_NET_CLOSE						3
+#define SANE_NET_GET_OPTION_DESCRIPTORS		4
+#define SANE_NET_CONTROL_OPTION				5
+#define SANE_NET_GET_PARAMETERS				6
+#define SANE_NET_START						7
+#define SANE_NET_CANCEL						8
+#define SANE_NET_AUTHORIZE					9
+#define SANE_NET_EXIT						10
+
+#define SANE_NET_PROTOCOL_VERSION			3
+
+#define SANE_STATUS_GOOD					0
+#define SANE_STATUS_UNSUPPORTED				1
+#define SANE_STATUS_CANCELLED				2
+#define SANE_STATUS_DEVICE_BUSY				3
+#define SANE_STATUS_INVAL					4
+#define SANE_STATUS_EOF						5
+#define SANE_STATUS_JAMMED					6
+#define SANE_STATUS_NO_DOCS					7
+#define SANE_STATUS_COVER_OPEN				8
+#define SANE_STATUS_IO_ERROR				9
+#define SANE_STATUS_NO_MEM					10
+#define SANE_STATUS_ACCESS_DENIED			11
+
+#define SANE_TYPE_BOOL						0
+#define SANE_TYPE_INT						1
+#define SANE_TYPE_FIXED						2
+#define SANE_TYPE_STRING					3
+#define SANE_TYPE_BUTTON					4
+#define SANE_TYPE_GROUP						5
+
+#define SANE_UNIT_NONE						0
+#define SANE_UNIT_PIXEL						1
+#define SANE_UNIT_BIT						2
+#define SANE_UNIT_MM						3
+#define SANE_UNIT_DPI						4
+#define SANE_UNIT_PERCENT					5
+#define SANE_UNIT_MICROSECOND				6
+
+#define SANE_CONSTRAINT_NONE				0
+#define SANE_CONSTRAINT_RANGE				1
+#define SANE_CONSTRAINT_WORD_LIST			2
+#define SANE_CONSTRAINT_STRING_LIST			3
+
+#define SANE_ACTION_GET_VALUE				0
+#define SANE_ACTION_SET_VALUE				1
+#define SANE_ACTION_SET_AUTO				2
+
+#define SANE_INFO_INEXACT					1
+#define SANE_INFO_RELOAD_OPTIONS			2
+#define SANE_INFO_RELOAD_PARAMS				4
+
+#define SANE_CAP_SOFT_SELECT				1
+#define SANE_CAP_HARD_SELECT				2
+#define SANE_CAP_SOFT_DETECT				4
+#define SANE_CAP_EMULATED					8
+#define SANE_CAP_AUTOMATIC					16
+#define SANE_CAP_INACTIVE					32
+#define SANE_CAP_ADVANCED					64
+
+#define SANE_FRAME_GRAY						0
+#define SANE_FRAME_RGB						1
+#define SANE_FRAME_RED						2
+#define SANE_FRAME_GREEN					3
+#define SANE_FRAME_BLUE						4
+
+#define SANE_DATA_END_OF_RECORDS			0xffffffff
+
+#endif /* __PACKET_SANE_H__ */
@@ -0,0 +1,732 @@
+/* sane-session.c
+ * State of a SANE control connection
+ *
+ * Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <epan/nstime.h>
+#include <epan/wmem/wmem.h>
+
+#include "packet-sane.h"
+#include "sane-session.h"
+
+/* Allocations of a session, counted into the size of its state */
+static void *sane_session_alloc0(sane_session_t *session, size_t size)
+{
+	session->state_size += size;
+	return wmem_alloc0(session->scope, size);
+}
+
+#define sane_session_new0(session, type) ((type*) sane_session_alloc0(session, sizeof(type)))
+
+static gchar *sane_session_strdup(sane_session_t *session, const gchar *src)
+{
+	session->state_size += strlen(src) + 1;
+	return wmem_strdup(session->scope, src);
+}
+
+sane_session_t *sane_session_new(wmem_allocator_t *scope, sane_registry_t *registry, guint32 id, const gchar *name)
+{
+	sane_session_t *session = NULL;
+
+	session = wmem_new0(scope, sane_session_t);
+	session->scope = scope;
+	session->registry = registry;
+	session->state_size = sizeof(sane_session_t);
+	session->id = id;
+	session->name = sane_session_strdup(session, name);
+	session->version = SANE_NET_PROTOCOL_VERSION;
+	session->rpc_queue = wmem_list_new(scope);
+	session->handles = wmem_tree_new(scope);
+	session->held = wmem_tree_new(scope);
+	session->options = wmem_tree_new(scope);
+
+	return session;
+}
+
+void sane_session_init(sane_session_t *session, guint32 version_code, const gchar *user_name)
+{
+	/* the build number of the version code is the protocol version */
+	session->version = version_code & 0xffff;
+	session->user_name = user_name ? sane_session_strdup(session, user_name) : NULL;
+}
+
+static void sane_session_set_handle(sane_session_t *session, guint32 handle, const gchar *device)
+{
+	session->have_handle = TRUE;
+	session->handle = handle;
+	session->device = device;
+}
+
+static void sane_device_release(sane_device_t *device, sane_session_t *session, const nstime_t *time,
+	sane_contention_t *contention)
+{
+	if (device->holder != session)
+		return;
+
+	if (contention) {
+		contention->have_hold = TRUE;
+		nstime_delta(&contention->hold, time, &device->hold_time);
+	}
+
+	device->holder = NULL;
+}
+
+typedef struct _sane_release_t {
+	sane_session_t *session;
+	const nstime_t *time;
+} sane_release_t;
+
+static gboolean sane_device_release_cb(void *value, void *userdata)
+{
+	sane_release_t *release = (sane_release_t*) userdata;
+
+	if (value)
+		sane_device_release((sane_device_t*) value, release->session, release->time, NULL);
+
+	return FALSE;
+}
+
+/* The job a SANE_NET_START request belongs to, a new one unless it continues the latest */
+static sane_job_t *sane_session_job(sane_session_t *session, guint32 handle, const nstime_t *time)
+{
+	sane_job_t *job = session->job;
+
+	if (job && !job->end_frame && job->handle == handle)
+		return job;
+
+	job = sane_session_new0(session, sane_job_t);
+	job->id = ++session->jobs;
+	job->handle = handle;
+	job->start_time = *time;
+	session->job = job;
+
+	return job;
+}
+
+sane_transaction_t *sane_session_request(sane_session_t *session, guint32 frame, const nstime_t *time,
+	guint32 rpc, guint32 handle, guint32 option, guint32 action, const gchar *device)
+{
+	sane_transaction_t *transaction = NULL;
+	sane_transaction_t *waiting = NULL;
+	sane_data_info_t *data_info = NULL;
+	sane_device_t *held = NULL;
+	sane_release_t release;
+
+	transaction = sane_session_new0(session, sane_transaction_t);
+	transaction->rpc = rpc;
+	transaction->req_frame = frame;
+	transaction->req_time = *time;
+	transaction->handle = handle;
+	transaction->option = option;
+	transaction->action = action;
+
+	switch (rpc) {
+		case SANE_NET_OPEN:
+			transaction->device = device ? sane_session_strdup(session, device) : NULL;
+		break;
+
+		case SANE_NET_INIT:
+		case SANE_NET_GET_DEVICES:
+		case SANE_NET_AUTHORIZE:
+		case SANE_NET_EXIT:
+			/* no handle */
+		break;
+
+		default:
+			transaction->have_handle = TRUE;
+			transaction->device = (const gchar*) wmem_tree_lookup32(session->handles, handle);
+			sane_session_set_handle(session, handle, transaction->device);
+		break;
+	}
+
+	if (rpc == SANE_NET_START)
+		transaction->job = sane_session_job(session, handle, time);
+
+	if (rpc == SANE_NET_CLOSE && session->job && !session->job->end_frame && session->job->handle == handle) {
+		transaction->job = session->job;
+		sane_job_end(session->job, frame, SANE_STATUS_GOOD);
+	}
+
+	/* closing the handle, or the whole session, gives the device free */
+	if (rpc == SANE_NET_CLOSE) {
+		held = (sane_device_t*) wmem_tree_lookup32(session->held, handle);
+		if (held) {
+			transaction->contention = sane_session_new0(session, sane_contention_t);
+			transaction->contention->device = held;
+			sane_device_release(held, session, time, transaction->contention);
+			wmem_tree_insert32(session->held, handle, NULL);
+		}
+	} else if (rpc == SANE_NET_EXIT) {
+		release.session = session;
+		release.time = time;
+		wmem_tree_foreach(session->held, sane_device_release_cb, &release);
+	}
+
+	if (rpc == SANE_NET_GET_OPTION_DESCRIPTORS) {
+		transaction->reload_frame = session->reload_frame;
+		session->reload_frame = 0;
+	}
+
+	if (rpc == SANE_NET_AUTHORIZE) {
+		waiting = sane_session_peek_reply(session);
+		if (waiting && waiting->auth_frame) {
+			/* answered before the actual reply of the request that asked for it */
+			transaction->authorizes = waiting;
+			wmem_list_prepend(session->rpc_queue, transaction);
+			return transaction;
+		}
+	}
+
+	data_info = session->data_info;
+	if (data_info && !data_info->end_frame && !data_info->cancelled) {
+		switch (rpc) {
+			case SANE_NET_CANCEL:
+				data_info->cancelled = TRUE;
+			break;
+
+			case SANE_NET_CLOSE:
+			case SANE_NET_START:
+				/* the data connection went away without an end-of-data record */
+				data_info->completeness = SANE_DATA_SHORT;
+				transaction->data_info = data_info;
+				session->data_info = NULL;
+			break;
+		}
+	}
+
+	wmem_list_append(session->rpc_queue, transaction);
+
+	return transaction;
+}
+
+sane_transaction_t *sane_session_peek_reply(const sane_session_t *session)
+{
+	wmem_list_frame_t *frame = wmem_list_head(session->rpc_queue);
+
+	return frame ? (sane_transaction_t*) wmem_list_frame_data(frame) : NULL;
+}
+
+sane_transaction_t *sane_session_reply(sane_session_t *session, guint32 frame, const nstime_t *time)
+{
+	wmem_list_frame_t *queue_frame = wmem_list_head(session->rpc_queue);
+	sane_transaction_t *transaction = NULL;
+
+	if (!queue_frame)
+		return NULL;
+
+	transaction = (sane_transaction_t*) wmem_list_frame_data(queue_frame);
+	wmem_list_remove_frame(session->rpc_queue, queue_frame);
+	transaction->rep_frame = frame;
+	if (transaction->auth_frame)
+		nstime_delta(&transaction->auth_delay, time, &transaction->auth_time);
+
+	return transaction;
+}
+
+void sane_session_authorization_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 frame,
+	const nstime_t *time)
+{
+	/* the actual reply is still to come */
+	transaction->rep_frame = 0;
+	if (!transaction->auth_frame)
+		transaction->auth_time = *time;
+	transaction->auth_frame = frame;
+	wmem_list_prepend(session->rpc_queue, transaction);
+}
+
+void sane_session_open_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 handle)
+{
+	transaction->have_handle = TRUE;
+	transaction->handle = handle;
+	wmem_tree_insert32(session->handles, handle, (void*) transaction->device);
+	sane_session_set_handle(session, handle, transaction->device);
+}
+
+void sane_session_device_opened(sane_session_t *session, sane_transaction_t *transaction, sane_device_t *device,
+	guint32 frame, const nstime_t *time)
+{
+	sane_contention_t *contention = NULL;
+
+	contention = sane_session_new0(session, sane_contention_t);
+	contention->device = device;
+	transaction->contention = contention;
+
+	/* the session got the device after being turned away */
+	if (session->busy_device == device) {
+		contention->retries = session->busy_retries;
+		contention->have_wait = TRUE;
+		nstime_delta(&contention->wait, time, &session->busy_since);
+		session->busy_device = NULL;
+	}
+
+	device->opens++;
+	sane_device_seen(device, frame);
+	device->holder = session;
+	device->hold_frame = frame;
+	device->hold_time = *time;
+	wmem_tree_insert32(session->held, transaction->handle, device);
+}
+
+void sane_session_device_busy(sane_session_t *session, sane_transaction_t *transaction, sane_device_t *device)
+{
+	sane_contention_t *contention = NULL;
+
+	if (session->busy_device != device) {
+		session->busy_device = device;
+		session->busy_since = transaction->req_time;
+		session->busy_retries = 0;
+	}
+
+	contention = sane_session_new0(session, sane_contention_t);
+	contention->device = device;
+	contention->retries = ++session->busy_retries;
+	if (device->holder) {
+		contention->holder = device->holder->name;
+		contention->hold_frame = device->hold_frame;
+	}
+	transaction->contention = contention;
+}
+
+void sane_session_control_option_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 frame,
+	guint32 info, guint32 size, guint32 crc)
+{
+	sane_option_value_t *option_value = NULL;
+	wmem_tree_key_t key[3];
+	guint32 key_handle = transaction->handle;
+	guint32 key_option = transaction->option;
+
+	key[0].length = 1;
+	key[0].key = &key_handle;
+	key[1].length = 1;
+	key[1].key = &key_option;
+	key[2].length = 0;
+	key[2].key = NULL;
+
+	option_value = (sane_option_value_t*) wmem_tree_lookup32_array(session->options, key);
+
+	if (transaction->action == SANE_ACTION_GET_VALUE && option_value &&
+		option_value->generation == session->option_generation &&
+		option_value->size == size && option_value->crc == crc) {
+		/* nothing happened that could have changed the value since the client got it */
+		transaction->unchanged_since = option_value->frame;
+	}
+
+	/* setting an option may change others, and a reload says they did */
+	if (transaction->action != SANE_ACTION_GET_VALUE || (info & SANE_INFO_RELOAD_OPTIONS))
+		session->option_generation++;
+
+	if (info & SANE_INFO_RELOAD_OPTIONS)
+		session->reload_frame = frame;
+
+	if (!option_value) {
+		option_value = sane_session_new0(session, sane_option_value_t);
+		wmem_tree_insert32_array(session->options, key, option_value);
+	}
+
+	if (!transaction->unchanged_since)
+		option_value->frame = frame;
+	option_value->generation = session->option_generation;
+	option_value->size = size;
+	option_value->crc = crc;
+}
+
+void sane_session_parameters_reply(sane_session_t *session, const sane_transaction_t *transaction,
+	const sane_parameters_t *parameters)
+{
+	sane_data_info_t *data_info = session->data_info;
+
+	session->have_parameters = TRUE;
+	session->parameters = *parameters;
+
+	/*
+	 * Clients like scanimage only ask for the parameters after
+	 * SANE_NET_START, so they belong to the transfer still running on the
+	 * handle, which got those of the frame before. Whether the frame
+	 * continues the image was already decided by the frame before, but
+	 * whether the next one does is only known now.
+	 */
+	if (!data_info || data_info->end_frame || !transaction->have_handle || transaction->handle != data_info->handle ||
+		transaction->req_frame < data_info->start_frame)
+		return;
+
+	data_info->have_parameters = TRUE;
+	data_info->parameters = *parameters;
+	session->image_frame = parameters->last_frame ? 0 : data_info->image_frame;
+}
+
+sane_data_info_t *sane_session_start_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 frame,
+	const nstime_t *time)
+{
+	sane_data_info_t *data_info = NULL;
+	sane_job_t *job = transaction->job;
+
+	data_info = sane_session_new0(session, sane_data_info_t);
+	data_info->session = session;
+	data_info->handle = transaction->handle;
+	data_info->device = transaction->device;
+	data_info->start_frame = frame;
+	data_info->start_time = *time;
+	nstime_delta(&data_info->feed_time, time, &transaction->req_time);
+	data_info->image_frame = ++session->image_frame;
+	data_info->completeness = SANE_DATA_UNKNOWN;
+	if (session->have_parameters) {
+		data_info->have_parameters = TRUE;
+		data_info->parameters = session->parameters;
+	}
+
+	/* a multi-frame image ends with the frame flagged as last frame */
+	if (!session->have_parameters || session->parameters.last_frame)
+		session->image_frame = 0;
+
+	if (job && !job->end_frame) {
+		data_info->job = job;
+		if (data_info->image_frame == 1)
+			job->pages++;
+		data_info->page = job->pages;
+
+		/* the time the client took before asking for the next page */
+		if (job->have_page_end) {
+			data_info->have_client_gap = TRUE;
+			nstime_delta(&data_info->client_gap, &transaction->req_time, &job->page_end_time);
+		}
+	}
+
+	transaction->started = data_info;
+	session->data_info = data_info;
+
+	return data_info;
+}
+
+sane_registry_t *sane_registry_new(wmem_allocator_t *scope)
+{
+	sane_registry_t *registry = NULL;
+
+	registry = wmem_new0(scope, sane_registry_t);
+	registry->scope = scope;
+	registry->devices = wmem_tree_new(scope);
+	registry->device_lists = wmem_tree_new(scope);
+
+	return registry;
+}
+
+/* The tree of a server within one of the trees of the registry */
+static wmem_tree_t *sane_registry_server(sane_registry_t *registry, wmem_tree_t *servers, const gchar *server)
+{
+	wmem_tree_t *tree = NULL;
+
+	tree = (wmem_tree_t*) wmem_tree_lookup_string(servers, server, 0);
+	if (!tree) {
+		tree = wmem_tree_new(registry->scope);
+		wmem_tree_insert_string(servers, server, tree, 0);
+	}
+
+	return tree;
+}
+
+sane_device_t *sane_device_get(sane_registry_t *registry, const gchar *server, const gchar *device)
+{
+	wmem_tree_t *server_devices = NULL;
+	sane_device_t *shared = NULL;
+
+	server_devices = sane_registry_server(registry, registry->devices, server);
+	shared = (sane_device_t*) wmem_tree_lookup_string(server_devices, device, 0);
+	if (!shared) {
+		shared = wmem_new0(registry->scope, sane_device_t);
+		shared->name = wmem_strdup_printf(registry->scope, "%s %s", server, device);
+		shared->server = wmem_strdup(registry->scope, server);
+		shared->device = wmem_strdup(registry->scope, device);
+		wmem_tree_insert_string(server_devices, device, shared, 0);
+	}
+
+	return shared;
+}
+
+void sane_device_seen(sane_device_t *device, guint32 frame)
+{
+	if (!device->first_seen)
+		device->first_seen = frame;
+	device->last_seen = frame;
+}
+
+/*
+ * The device list of a SANE_NET_GET_DEVICES reply with the same length
+ * and hash, NULL if the server did not send that list before.
+ */
+sane_device_list_t *sane_device_list_lookup(sane_registry_t *registry, const gchar *server, guint32 len, guint32 hash)
+{
+	wmem_tree_key_t key[3];
+
+	key[0].length = 1;
+	key[0].key = &len;
+	key[1].length = 1;
+	key[1].key = &hash;
+	key[2].length = 0;
+	key[2].key = NULL;
+
+	return (sane_device_list_t*) wmem_tree_lookup32_array(sane_registry_server(registry, registry->device_lists, server), key);
+}
+
+/* An empty device list with room for max_count devices */
+sane_device_list_t *sane_device_list_new(sane_registry_t *registry, const gchar *server, guint32 len, guint32 hash,
+	guint32 frame, guint32 max_count)
+{
+	sane_device_list_t *device_list = NULL;
+	wmem_tree_key_t key[3];
+
+	device_list = wmem_new0(registry->scope, sane_device_list_t);
+	device_list->frame = frame;
+	device_list->devices = (sane_device_t**) wmem_alloc0(registry->scope, max_count * sizeof(sane_device_t*));
+	device_list->vendors = (const gchar**) wmem_alloc0(registry->scope, max_count * sizeof(const gchar*));
+	device_list->models = (const gchar**) wmem_alloc0(registry->scope, max_count * sizeof(const gchar*));
+	device_list->types = (const gchar**) wmem_alloc0(registry->scope, max_count * sizeof(const gchar*));
+
+	key[0].length = 1;
+	key[0].key = &len;
+	key[1].length = 1;
+	key[1].key = &hash;
+	key[2].length = 0;
+	key[2].key = NULL;
+
+	wmem_tree_insert32_array(sane_registry_server(registry, registry->device_lists, server), key, device_list);
+
+	return device_list;
+}
+
+/*
+ * Adds a device to a list with its current description, which the list
+ * keeps even if a later list describes the device differently.
+ */
+void sane_device_list_add(sane_device_list_t *device_list, sane_device_t *device)
+{
+	device_list->devices[device_list->count] = device;
+	device_list->vendors[device_list->count] = device->vendor;
+	device_list->models[device_list->count] = device->model;
+	device_list->types[device_list->count] = device->type;
+	device_list->count++;
+}
+
+void sane_device_describe(sane_device_t *device, wmem_allocator_t *scope, const gchar *vendor, const gchar *model,
+	const gchar *type)
+{
+	/* a device keeps its description, only a changed one costs new strings */
+	if (!device->vendor || strcmp(device->vendor, vendor))
+		device->vendor = wmem_strdup(scope, vendor);
+	if (!device->model || strcmp(device->model, model))
+		device->model = wmem_strdup(scope, model);
+	if (!device->type || strcmp(device->type, type))
+		device->type = wmem_strdup(scope, type);
+}
+
+void sane_job_end(sane_job_t *job, guint32 frame, guint32 status)
+{
+	job->end_frame = frame;
+	job->end_status = status;
+	if (job->have_page_end)
+		nstime_delta(&job->duration, &job->page_end_time, &job->start_time);
+}
+
+void sane_session_status(sane_session_t *session, guint32 status)
+{
+	session->have_status = TRUE;
+	session->status = status;
+}
+
+/* Range of payload seen beyond a gap that contains seq_pos, -1 if none */
+static gint sane_seq_find_range(const sane_seq_t *seq, guint32 seq_pos)
+{
+	guint i;
+
+	for (i = 0; i < seq->range_count; i++) {
+		if ((gint32) (seq_pos - seq->ranges[i].start) >= 0 && (gint32) (seq_pos - seq->ranges[i].end) < 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Drops the first count ranges */
+static void sane_seq_drop_ranges(sane_seq_t *seq, guint count)
+{
+	seq->range_count -= count;
+	memmove(seq->ranges, seq->ranges + count, seq->range_count * sizeof(sane_seq_range_t));
+}
+
+/* Moves the end of the payload seen without gaps to seq_end, taking up the ranges that now join it */
+static void sane_seq_advance(sane_seq_t *seq, guint32 seq_end)
+{
+	guint joined = 0;
+
+	seq->nxtseq = seq_end;
+
+	while (joined < seq->range_count && (gint32) (seq->ranges[joined].start - seq->nxtseq) <= 0) {
+		if ((gint32) (seq->ranges[joined].end - seq->nxtseq) > 0)
+			seq->nxtseq = seq->ranges[joined].end;
+		joined++;
+	}
+
+	sane_seq_drop_ranges(seq, joined);
+}
+
+/* Adds payload beyond a gap, merged with the ranges it overlaps or touches */
+static void sane_seq_add_range(sane_seq_t *seq, guint32 seq_start, guint32 seq_end)
+{
+	guint first = 0;
+	guint last = 0;
+
+	/* ranges wholly before it */
+	while (first < seq->range_count && (gint32) (seq->ranges[first].end - seq_start) < 0)
+		first++;
+
+	/* ranges it overlaps or touches */
+	for (last = first; last < seq->range_count && (gint32) (seq_end - seq->ranges[last].start) >= 0; last++) {
+		if ((gint32) (seq->ranges[last].start - seq_start) < 0)
+			seq_start = seq->ranges[last].start;
+		if ((gint32) (seq->ranges[last].end - seq_end) > 0)
+			seq_end = seq->ranges[last].end;
+	}
+
+	if (first == last && seq->range_count == SANE_SEQ_MAX_RANGES) {
+		/* too many gaps, the first one won't be filled any more */
+		if (first == 0) {
+			sane_seq_advance(seq, seq_end);
+			return;
+		}
+		sane_seq_advance(seq, seq->ranges[0].end);
+		first--;
+		last--;
+	}
+
+	if (last != first + 1)
+		memmove(seq->ranges + first + 1, seq->ranges + last, (seq->range_count - last) * sizeof(sane_seq_range_t));
+	seq->range_count = seq->range_count - (last - first) + 1;
+	seq->ranges[first].start = seq_start;
+	seq->ranges[first].end = seq_end;
+}
+
+/*
+ * Bytes at the start of a segment that earlier frames already carried,
+ * like a TCP retransmission that may also carry new payload. All of the
+ * segment if it only repeats payload, 0 if it starts with new payload.
+ * Segments that arrive out of order only count as repeated where they
+ * fall into payload actually seen, not into a gap before it. Several
+ * calls for the same frame, e.g. for the PDUs following a reassembled
+ * one, all count as new.
+ *
+ * TCP keeps the segments within a PDU it reassembles from the dissector
+ * and only passes the segment completing it, as reassembled, so the gap
+ * before such a segment is payload seen, and its sequence numbers do not
+ * match the reassembled buffer. It always counts as new.
+ */
+guint32 sane_seq_seen(sane_seq_t *seq, guint32 frame, guint32 seq_start, guint32 seq_end, gboolean reassembled)
+{
+	gint range = -1;
+	guint32 seen = 0;
+
+	if (seq_start == seq_end || (seq->valid && seq->frame == frame))
+		return 0;
+
+	if (reassembled) {
+		if (!seq->valid || (gint32) (seq_end - seq->nxtseq) > 0) {
+			seq->valid = TRUE;
+			sane_seq_advance(seq, seq_end);
+		}
+		seq->frame = frame;
+		return 0;
+	}
+
+	if (!seq->valid) {
+		seq->valid = TRUE;
+		seq->nxtseq = seq_end;
+		seq->frame = frame;
+		return 0;
+	}
+
+	/* within or continuing the payload seen without gaps */
+	if ((gint32) (seq_start - seq->nxtseq) <= 0) {
+		if ((gint32) (seq_end - seq->nxtseq) <= 0)
+			return seq_end - seq_start;
+
+		seen = seq->nxtseq - seq_start;
+		sane_seq_advance(seq, seq_end);
+		seq->frame = frame;
+		return seen;
+	}
+
+	/* beyond a gap, a segment got lost or arrives out of order */
+	range = sane_seq_find_range(seq, seq_start);
+	if (range >= 0) {
+		if ((gint32) (seq_end - seq->ranges[range].end) <= 0)
+			return seq_end - seq_start;
+		seen = seq->ranges[range].end - seq_start;
+	}
+
+	sane_seq_add_range(seq, seq_start, seq_end);
+	seq->frame = frame;
+	return seen;
+}
+
+static void check_sane_data_completeness(sane_data_info_t *data_info)
+{
+	guint64 expected = 0;
+
+	if (!data_info->have_parameters || !data_info->parameters.bytes_per_line) {
+		data_info->completeness = SANE_DATA_UNKNOWN;
+		return;
+	}
+
+	if (data_info->parameters.lines < 0) {
+		/* unknown length scans must at least deliver whole lines */
+		if (data_info->bytes_received % data_info->parameters.bytes_per_line)
+			data_info->completeness = SANE_DATA_SHORT;
+		else
+			data_info->completeness = SANE_DATA_COMPLETE;
+		return;
+	}
+
+	expected = (guint64) data_info->parameters.bytes_per_line * data_info->parameters.lines;
+	if (data_info->bytes_received < expected)
+		data_info->completeness = SANE_DATA_SHORT;
+	else if (data_info->bytes_received > expected)
+		data_info->completeness = SANE_DATA_OVERLONG;
+	else
+		data_info->completeness = SANE_DATA_COMPLETE;
+}
+
+void sane_data_record(sane_data_info_t *data_info, guint32 frame, const nstime_t *time, guint32 len)
+{
+	if (data_info->end_frame)
+		return;
+
+	if (len == SANE_DATA_END_OF_RECORDS) {
+		data_info->end_frame = frame;
+		nstime_delta(&data_info->transfer_time, time, &data_info->start_time);
+		check_sane_data_completeness(data_info);
+
+		if (data_info->job && !data_info->job->end_frame) {
+			data_info->job->have_page_end = TRUE;
+			data_info->job->page_end_time = *time;
+		}
+	} else
+		data_info->bytes_received += len;
+}
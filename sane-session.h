@@ -0,0 +1,282 @@
+/* sane-session.h
+ * State of a SANE control connection
+ *
+ * Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __SANE_SESSION_H__
+#define __SANE_SESSION_H__
+
+#include <glib.h>
+#include <epan/nstime.h>
+#include <epan/wmem/wmem.h>
+
+#define SANE_DATA_UNKNOWN					0
+#define SANE_DATA_COMPLETE					1
+#define SANE_DATA_SHORT						2
+#define SANE_DATA_OVERLONG					3
+
+/* gaps kept open at once, a segment beyond more of them gives up the first */
+#define SANE_SEQ_MAX_RANGES					8
+
+typedef struct _sane_seq_range_t {
+	guint32 start;
+	guint32 end;
+} sane_seq_range_t;
+
+/* TCP payload seen so far in one direction of a connection */
+typedef struct _sane_seq_t {
+	gboolean valid;
+	guint32 nxtseq;					/* end of the payload seen without gaps */
+	guint32 frame;					/* latest frame that carried new payload */
+	guint range_count;
+	sane_seq_range_t ranges[SANE_SEQ_MAX_RANGES];	/* payload seen beyond a gap, in sequence order */
+} sane_seq_t;
+
+/* Position within the records of a data connection that is walked header by header */
+typedef struct _sane_data_walk_t {
+	guint32 remaining;				/* bytes of the current record still to come */
+	guint32 header_len;				/* bytes of a length header split across segments */
+	guint8 header[4];
+	guint32 records;				/* record headers walked so far */
+	guint64 bytes;					/* record payload walked so far */
+	gboolean status_pending;		/* the end-of-data record still lacks its status byte */
+	gboolean ended;
+} sane_data_walk_t;
+
+/* Image parameters announced by a SANE_NET_GET_PARAMETERS reply */
+typedef struct _sane_parameters_t {
+	guint32 frame;					/* frame number of the reply */
+	guint32 format;
+	gboolean last_frame;
+	guint32 bytes_per_line;
+	guint32 pixels_per_line;
+	gint32 lines;					/* -1 if unknown in advance */
+	guint32 depth;
+} sane_parameters_t;
+
+/*
+ * Pages scanned with repeated SANE_NET_START requests on one handle, as
+ * done for documents from an automatic document feeder. A job ends when
+ * SANE_NET_START fails, usually with SANE_STATUS_NO_DOCS, or the handle
+ * is closed.
+ */
+typedef struct _sane_job_t {
+	guint32 id;						/* position within the session, starting at 1 */
+	guint32 handle;
+	nstime_t start_time;			/* first SANE_NET_START request */
+	guint32 pages;
+	gboolean have_page_end;
+	nstime_t page_end_time;			/* end-of-data record of the latest page */
+	guint32 end_frame;				/* frame that ended the job, 0 while running */
+	guint32 end_status;				/* status of the failed SANE_NET_START, SANE_STATUS_GOOD if closed */
+	nstime_t duration;				/* from the first SANE_NET_START request to the end of the latest page */
+} sane_job_t;
+
+/* State of an image data connection announced by a SANE_NET_START reply */
+typedef struct _sane_data_info_t {
+	guint32 start_frame;			/* frame number of the SANE_NET_START reply */
+	guint32 end_frame;				/* frame number of the end-of-data record, 0 while in progress */
+	guint32 image_frame;			/* position within a multi-frame image, starting at 1 */
+	gboolean have_parameters;
+	sane_parameters_t parameters;
+	guint64 bytes_received;
+	guint32 completeness;
+	gboolean cancelled;
+	sane_seq_t seq;
+	sane_data_walk_t walk;
+	struct _sane_session_t *session;	/* control connection that announced the transfer */
+	guint32 handle;					/* handle of the SANE_NET_START request */
+	const gchar *device;			/* NULL if unknown */
+	sane_job_t *job;
+	guint32 page;					/* page of the job, a multi-frame image is one page */
+	nstime_t start_time;			/* SANE_NET_START reply */
+	nstime_t feed_time;				/* from the SANE_NET_START request to its reply */
+	gboolean have_client_gap;
+	nstime_t client_gap;			/* from the end of the previous page to the SANE_NET_START request */
+	nstime_t transfer_time;			/* from the SANE_NET_START reply to the end-of-data record */
+} sane_data_info_t;
+
+/* A device of a server, shared by all sessions with that server, see sane_device_get() */
+typedef struct _sane_device_t {
+	const gchar *name;				/* server and device name */
+	const gchar *server;
+	const gchar *device;
+	const gchar *vendor;			/* as listed by SANE_NET_GET_DEVICES, NULL if never listed */
+	const gchar *model;
+	const gchar *type;
+	guint32 first_seen;				/* first and latest frame that listed or opened the device */
+	guint32 last_seen;
+	guint32 opens;					/* successful SANE_NET_OPEN replies */
+	struct _sane_session_t *holder;	/* session that has the device open, NULL if none */
+	guint32 hold_frame;				/* SANE_NET_OPEN reply that gave the holder the device */
+	nstime_t hold_time;
+} sane_device_t;
+
+/*
+ * Devices of the servers in a capture, passed in by the caller of every
+ * function that looks them up. All of it is allocated from the scope the
+ * registry was created with, so the sessions sharing one registry have to
+ * be driven together, while separate registries are independent.
+ */
+typedef struct _sane_registry_t {
+	wmem_allocator_t *scope;
+	wmem_tree_t *devices;			/* trees of devices by device name, by server name */
+	wmem_tree_t *device_lists;		/* trees of device lists by length and hash, by server name */
+} sane_registry_t;
+
+/* Devices of a SANE_NET_GET_DEVICES reply, shared by all replies with the same list */
+typedef struct _sane_device_list_t {
+	guint32 frame;					/* first reply with the list */
+	guint32 count;
+	sane_device_t **devices;
+	const gchar **vendors;			/* description of each device as listed, see sane_device_list_add() */
+	const gchar **models;
+	const gchar **types;
+} sane_device_list_t;
+
+/* Contention for a device as seen by a SANE_NET_OPEN reply or SANE_NET_CLOSE request */
+typedef struct _sane_contention_t {
+	sane_device_t *device;
+	const gchar *holder;			/* busy replies: session holding the device, NULL if unknown */
+	guint32 hold_frame;				/* busy replies: reply that gave the holder the device */
+	guint32 retries;				/* busy replies in a row, up to this one */
+	gboolean have_wait;
+	nstime_t wait;					/* successful replies: from the first busy request to this reply */
+	gboolean have_hold;
+	nstime_t hold;					/* SANE_NET_CLOSE: how long the device was held */
+} sane_contention_t;
+
+/*
+ * A request and the reply matched to it. When saned needs authorization
+ * it first replies with the resource to authorize, the client answers with
+ * SANE_NET_AUTHORIZE and the actual reply follows after that one's reply.
+ */
+typedef struct _sane_transaction_t {
+	guint32 rpc;
+	guint32 req_frame;
+	guint32 rep_frame;				/* 0 while the reply is outstanding */
+	nstime_t req_time;
+	guint32 auth_frame;				/* latest reply asking for authorization, 0 if none */
+	nstime_t auth_time;
+	nstime_t auth_delay;			/* from the first reply asking for authorization to the actual reply */
+	struct _sane_transaction_t *authorizes;	/* SANE_NET_AUTHORIZE only: request waiting for it */
+	gboolean have_handle;			/* the request refers to a handle, or the reply opened one */
+	guint32 handle;
+	const gchar *device;			/* device name the request refers to, NULL if unknown */
+	guint32 option;					/* SANE_NET_CONTROL_OPTION only */
+	guint32 action;					/* SANE_NET_CONTROL_OPTION only */
+	guint32 unchanged_since;		/* reply of an earlier GET_VALUE with the same option value */
+	guint32 reload_frame;			/* reply that asked for the descriptors to be reloaded */
+	sane_data_info_t *data_info;	/* data connection that went away without an end-of-data record */
+	sane_data_info_t *started;		/* SANE_NET_START only: data connection announced by the reply */
+	sane_job_t *job;				/* SANE_NET_START, and SANE_NET_CLOSE that ended a job */
+	sane_contention_t *contention;	/* SANE_NET_OPEN replies and SANE_NET_CLOSE, NULL if not tracked */
+	const sane_device_list_t *device_list;	/* SANE_NET_GET_DEVICES only */
+} sane_transaction_t;
+
+/* Value of an option as seen in the latest SANE_NET_CONTROL_OPTION reply */
+typedef struct _sane_option_value_t {
+	guint32 frame;					/* frame number of the reply the value was first seen in */
+	guint32 generation;
+	guint32 size;
+	guint32 crc;
+} sane_option_value_t;
+
+/*
+ * State of a control connection. A session only ever touches its own
+ * members and the devices passed to it, and allocates from the scope it
+ * was created with, so separate sessions can be driven from separate
+ * threads as long as they share neither a scope nor a registry. Within a
+ * session, the calls have to be made in the order of the PDUs on the wire.
+ */
+typedef struct _sane_session_t {
+	wmem_allocator_t *scope;
+	sane_registry_t *registry;		/* devices of the servers, shared with the other sessions of the capture */
+	gsize state_size;				/* bytes allocated for the session, not counting list and tree nodes */
+	guint32 id;						/* index of the connection within the capture */
+	const gchar *name;				/* client and server end points */
+	guint32 version;				/* protocol version of the SANE_NET_INIT request */
+	const gchar *user_name;			/* user name of the SANE_NET_INIT request, NULL if not seen */
+	const gchar *device;			/* device of the latest request or reply that had a handle */
+	gboolean have_handle;
+	guint32 handle;					/* handle of the latest request or reply that had one */
+	gboolean have_status;
+	guint32 status;					/* status of the latest reply or end-of-data record */
+	wmem_list_t *rpc_queue;			/* transactions waiting for their reply */
+	wmem_tree_t *handles;			/* device names by handle of SANE_NET_OPEN */
+	wmem_tree_t *options;			/* option values by handle and option number */
+	guint32 option_generation;		/* changes whenever option values may have changed */
+	guint32 reload_frame;			/* reply that asked for the descriptors to be reloaded */
+	gboolean have_parameters;
+	sane_parameters_t parameters;	/* latest successful SANE_NET_GET_PARAMETERS reply */
+	guint32 image_frame;			/* frames announced so far for the current image */
+	sane_data_info_t *data_info;	/* data connection of the latest SANE_NET_START */
+	wmem_tree_t *held;				/* devices by handle, NULL once closed */
+	sane_device_t *busy_device;		/* device the session keeps getting busy replies for */
+	nstime_t busy_since;			/* first SANE_NET_OPEN request that got one */
+	guint32 busy_retries;
+	guint32 jobs;					/* jobs started so far */
+	sane_job_t *job;				/* latest job */
+	sane_seq_t seq[2];				/* requests and replies */
+} sane_session_t;
+
+sane_session_t *sane_session_new(wmem_allocator_t *scope, sane_registry_t *registry, guint32 id, const gchar *name);
+
+/* Requests */
+void sane_session_init(sane_session_t *session, guint32 version_code, const gchar *user_name);
+sane_transaction_t *sane_session_request(sane_session_t *session, guint32 frame, const nstime_t *time,
+	guint32 rpc, guint32 handle, guint32 option, guint32 action, const gchar *device);
+
+/* Replies, matched against the oldest outstanding request */
+sane_transaction_t *sane_session_peek_reply(const sane_session_t *session);
+sane_transaction_t *sane_session_reply(sane_session_t *session, guint32 frame, const nstime_t *time);
+void sane_session_authorization_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 frame,
+	const nstime_t *time);
+void sane_session_open_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 handle);
+void sane_session_device_opened(sane_session_t *session, sane_transaction_t *transaction, sane_device_t *device,
+	guint32 frame, const nstime_t *time);
+void sane_session_device_busy(sane_session_t *session, sane_transaction_t *transaction, sane_device_t *device);
+void sane_session_control_option_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 frame,
+	guint32 info, guint32 size, guint32 crc);
+void sane_session_parameters_reply(sane_session_t *session, const sane_transaction_t *transaction,
+	const sane_parameters_t *parameters);
+sane_data_info_t *sane_session_start_reply(sane_session_t *session, sane_transaction_t *transaction, guint32 frame,
+	const nstime_t *time);
+void sane_session_status(sane_session_t *session, guint32 status);
+
+/* Retransmitted and duplicated segments */
+guint32 sane_seq_seen(sane_seq_t *seq, guint32 frame, guint32 seq_start, guint32 seq_end, gboolean reassembled);
+
+/* Devices shared by the sessions with a server, by server and device name */
+sane_registry_t *sane_registry_new(wmem_allocator_t *scope);
+sane_device_t *sane_device_get(sane_registry_t *registry, const gchar *server, const gchar *device);
+void sane_device_seen(sane_device_t *device, guint32 frame);
+sane_device_list_t *sane_device_list_lookup(sane_registry_t *registry, const gchar *server, guint32 len, guint32 hash);
+sane_device_list_t *sane_device_list_new(sane_registry_t *registry, const gchar *server, guint32 len, guint32 hash,
+	guint32 frame, guint32 max_count);
+void sane_device_list_add(sane_device_list_t *device_list, sane_device_t *device);
+void sane_device_describe(sane_device_t *device, wmem_allocator_t *scope, const gchar *vendor, const gchar *model,
+	const gchar *type);
+
+/* Jobs of consecutive SANE_NET_START requests */
+void sane_job_end(sane_job_t *job, guint32 frame, guint32 status);
+
+/* Image data connections */
+void sane_data_record(sane_data_info_t *data_info, guint32 frame, const nstime_t *time, guint32 len);
+
+#endif /* __SANE_SESSION_H__ */
@@ -0,0 +1,364 @@
+#!/usr/bin/env python
+# sane-batch.py
+# Analyse a directory of capture files with the SANE dissector in parallel
+#
+# Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+"""
+Runs tshark with the SANE plugin over every capture file of a directory,
+one worker process per file. Files are handed out largest first and each
+worker fetches the next file as soon as it is done, so files of unequal
+size keep all cores busy. Every worker returns the partial statistics of
+its file, which are merged by the parent process only, without any
+shared state between the workers.
+
+Usage: sane-batch.py [-j JOBS] [--tshark PATH] [--json FILE] DIRECTORY
+"""
+
+from __future__ import print_function
+
+import fnmatch
+import json
+import multiprocessing
+import optparse
+import os
+import sys
+
+import saneproto
+
+FRAME_FIELDS = (
+    'frame.number',
+    'frame.time_epoch',
+    'tcp.stream',
+    'ip.src',
+    'ipv6.src',
+    'ip.dst',
+    'ipv6.dst',
+)
+
+PDU_FIELDS = (
+    'sane.rpc.code',
+    'sane.rpc.status',
+    'sane.response_to',
+    'sane.srt',
+    'sane.net.user_name',
+    'sane.net.device.name',
+    'sane.net.handle',
+    'sane.net.resource',
+    'sane.data.start_in',
+    'sane.data.bytes_received',
+    'sane.data.completeness',
+)
+
+# Same buckets as the "SANE/Response Time" statistics tree
+LATENCY_BUCKETS = (
+    (1, '0-1'),
+    (10, '1-10'),
+    (100, '10-100'),
+    (1000, '100-1000'),
+    (10000, '1000-10000'),
+    (None, '10000-'),
+)
+
+UNKNOWN_DEVICE = '(unknown)'
+
+
+def latency_bucket(msec):
+    for limit, name in LATENCY_BUCKETS:
+        if limit is None or msec < limit:
+            return name
+
+
+def new_stats():
+    return {
+        'files': 0,
+        'frames': 0,
+        'failed': [],
+        'latency': {},
+        'latency_total': {},
+        'device_rpcs': {},
+        'device_errors': {},
+        'jobs': [],
+    }
+
+
+def count(table, key, value=1):
+    table[key] = table.get(key, 0) + value
+
+
+class Session(object):
+    """State of one SANE control connection while reading its frames."""
+
+    def __init__(self, capture, stream, client, server, first_seen):
+        self.pending = {}
+        self.handles = {}
+        self.job = {
+            'file': capture,
+            'stream': stream,
+            'client': client,
+            'server': server,
+            'user': None,
+            'devices': [],
+            'first_seen': first_seen,
+            'last_seen': first_seen,
+            'rpcs': 0,
+            'errors': 0,
+            'scans': 0,
+            'bytes': 0,
+            'complete': 0,
+            'short': 0,
+            'overlong': 0,
+        }
+
+    def device_of(self, request):
+        rpc, handle, device = request
+        if rpc == saneproto.SANE_NET_OPEN:
+            return device or UNKNOWN_DEVICE
+        return self.handles.get(handle, UNKNOWN_DEVICE)
+
+
+def to_int(value):
+    if not value:
+        return None
+    return int(value, 0)
+
+
+def analyse_file(args):
+    """Worker: dissect one capture file and return its partial statistics."""
+    tshark, capture = args
+    stats = new_stats()
+    stats['files'] = 1
+
+    sessions = {}
+    start_sessions = {}
+    frames = set()
+
+    try:
+        for row in saneproto.tshark_pdus(tshark, capture, 'sane', FRAME_FIELDS, PDU_FIELDS):
+            frames.add(row['frame.number'])
+            analyse_pdu(row, capture, stats, sessions, start_sessions)
+    except saneproto.TsharkError as error:
+        stats['failed'].append((capture, str(error)))
+
+    stats['frames'] = len(frames)
+    stats['jobs'] = [session.job for session in sessions.values()]
+    return stats
+
+
+def analyse_pdu(row, capture, stats, sessions, start_sessions):
+    """Account one SANE PDU of a capture to its session."""
+    frame = int(row['frame.number'])
+    timestamp = float(row['frame.time_epoch'])
+    stream = row['tcp.stream']
+
+    if row['sane.data.completeness']:
+        # end of an image data transfer, account it to its control connection
+        session = start_sessions.get(int(row['sane.data.start_in']))
+        if session:
+            job = session.job
+            job['bytes'] += int(row['sane.data.bytes_received'] or 0)
+            completeness = int(row['sane.data.completeness'])
+            if completeness == saneproto.SANE_DATA_COMPLETE:
+                job['complete'] += 1
+            elif completeness == saneproto.SANE_DATA_SHORT:
+                job['short'] += 1
+            elif completeness == saneproto.SANE_DATA_OVERLONG:
+                job['overlong'] += 1
+        return
+
+    rpc = to_int(row['sane.rpc.code'])
+    if rpc is None:
+        return
+
+    request = not row['sane.response_to']
+    src = row['ip.src'] or row['ipv6.src']
+    dst = row['ip.dst'] or row['ipv6.dst']
+
+    session = sessions.get(stream)
+    if not session:
+        if request:
+            session = Session(capture, stream, src, dst, timestamp)
+        else:
+            session = Session(capture, stream, dst, src, timestamp)
+        sessions[stream] = session
+    job = session.job
+    job['last_seen'] = timestamp
+
+    if request:
+        job['rpcs'] += 1
+        if rpc == saneproto.SANE_NET_INIT and row['sane.net.user_name']:
+            job['user'] = row['sane.net.user_name']
+        if row['sane.data.start_in']:
+            # a transfer of this session ended without end-of-data record
+            job['short'] += 1
+        session.pending[frame] = (rpc, to_int(row['sane.net.handle']),
+                                  row['sane.net.device.name'])
+        return
+
+    if row['sane.net.resource']:
+        # asks for authorization, the actual reply follows later
+        return
+
+    origin = session.pending.pop(int(row['sane.response_to']), None)
+    if not origin:
+        return
+
+    name = saneproto.code_name(rpc)
+    device = session.device_of(origin)
+    count(stats['device_rpcs'], device)
+
+    if row['sane.srt']:
+        msec = float(row['sane.srt']) * 1000.0
+        count(stats['latency'].setdefault(name, {}), latency_bucket(msec))
+        total = stats['latency_total'].setdefault(name, [0, 0.0])
+        total[0] += 1
+        total[1] += msec
+
+    status = to_int(row['sane.rpc.status'])
+    if status not in (None, saneproto.SANE_STATUS_GOOD):
+        job['errors'] += 1
+        errors = stats['device_errors'].setdefault(device, {})
+        count(errors, '%s/%s' % (name, saneproto.status_name(status)))
+
+    if status == saneproto.SANE_STATUS_GOOD:
+        if rpc == saneproto.SANE_NET_OPEN:
+            handle = to_int(row['sane.net.handle'])
+            session.handles[handle] = device
+            if device not in job['devices']:
+                job['devices'].append(device)
+        elif rpc == saneproto.SANE_NET_START:
+            job['scans'] += 1
+            start_sessions[frame] = session
+
+
+
+def merge_stats(total, partial):
+    """Merge the partial statistics of one file into the totals."""
+    total['files'] += partial['files']
+    total['frames'] += partial['frames']
+    total['failed'].extend(partial['failed'])
+    total['jobs'].extend(partial['jobs'])
+
+    for name, buckets in partial['latency'].items():
+        merged = total['latency'].setdefault(name, {})
+        for bucket, value in buckets.items():
+            count(merged, bucket, value)
+
+    for name, (calls, msec) in partial['latency_total'].items():
+        merged = total['latency_total'].setdefault(name, [0, 0.0])
+        merged[0] += calls
+        merged[1] += msec
+
+    for device, value in partial['device_rpcs'].items():
+        count(total['device_rpcs'], device, value)
+
+    for device, errors in partial['device_errors'].items():
+        merged = total['device_errors'].setdefault(device, {})
+        for error, value in errors.items():
+            count(merged, error, value)
+
+
+def print_report(stats, out=sys.stdout):
+    print('Files analysed: %d, SANE frames: %d' % (stats['files'], stats['frames']), file=out)
+    for capture, error in stats['failed']:
+        print('  failed: %s: %s' % (capture, error), file=out)
+
+    print('', file=out)
+    print('Response time per RPC (ms)', file=out)
+    header = ''.join('%12s' % name for _, name in LATENCY_BUCKETS)
+    print('  %-32s%8s%10s%s' % ('RPC', 'Count', 'Avg', header), file=out)
+    for name in sorted(stats['latency']):
+        calls, msec = stats['latency_total'][name]
+        buckets = stats['latency'][name]
+        row = ''.join('%12d' % buckets.get(bucket, 0) for _, bucket in LATENCY_BUCKETS)
+        print('  %-32s%8d%10.2f%s' % (name, calls, msec / calls, row), file=out)
+
+    print('', file=out)
+    print('Errors per device', file=out)
+    for device in sorted(stats['device_rpcs']):
+        errors = stats['device_errors'].get(device, {})
+        failed = sum(errors.values())
+        calls = stats['device_rpcs'][device]
+        print('  %s: %d of %d replies failed (%.2f%%)' % (
+            device, failed, calls, 100.0 * failed / calls), file=out)
+        for error in sorted(errors):
+            print('    %-64s%8d' % (error, errors[error]), file=out)
+
+    print('', file=out)
+    print('Jobs', file=out)
+    for job in sorted(stats['jobs'], key=lambda job: job['first_seen']):
+        print('  %s stream %s: %s -> %s user %s devices %s: %d RPCs, %d errors, '
+              '%d scans, %d bytes (%d complete, %d short, %d over-long), %.3fs' % (
+                  os.path.basename(job['file']), job['stream'], job['client'],
+                  job['server'], job['user'] or '-', ','.join(job['devices']) or '-',
+                  job['rpcs'], job['errors'], job['scans'], job['bytes'],
+                  job['complete'], job['short'], job['overlong'],
+                  job['last_seen'] - job['first_seen']), file=out)
+
+
+def find_captures(directory, pattern):
+    captures = []
+    for name in os.listdir(directory):
+        path = os.path.join(directory, name)
+        if name.startswith('.') or not os.path.isfile(path):
+            continue
+        if pattern and not fnmatch.fnmatch(name, pattern):
+            continue
+        captures.append(path)
+    # largest first, so that the big files do not end up as the tail
+    captures.sort(key=os.path.getsize, reverse=True)
+    return captures
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] DIRECTORY')
+    parser.add_option('-j', '--jobs', type='int', default=multiprocessing.cpu_count(),
+                      help='number of worker processes [default: %default]')
+    parser.add_option('-p', '--pattern', default=None,
+                      help='only analyse files matching this shell pattern')
+    parser.add_option('--tshark', default='tshark',
+                      help='tshark binary to use [default: %default]')
+    parser.add_option('--json', metavar='FILE',
+                      help='also write the merged statistics as JSON to FILE')
+    options, args = parser.parse_args()
+    if len(args) != 1:
+        parser.error('expected exactly one capture directory')
+
+    captures = find_captures(args[0], options.pattern)
+    if not captures:
+        parser.error('no capture files found in %s' % args[0])
+
+    total = new_stats()
+    pool = multiprocessing.Pool(processes=max(1, min(options.jobs, len(captures))))
+    try:
+        work = [(options.tshark, capture) for capture in captures]
+        for partial in pool.imap_unordered(analyse_file, work, chunksize=1):
+            merge_stats(total, partial)
+    finally:
+        pool.close()
+        pool.join()
+
+    print_report(total)
+    if options.json:
+        with open(options.json, 'w') as out:
+            json.dump(total, out, indent=1, sort_keys=True)
+
+    return 1 if total['failed'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,661 @@
+#!/usr/bin/env python
+# sane-emulator.py
+# Emulate a saned with synthetic devices for closed-loop tests of the SANE dissector
+#
+# Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+"""
+Speaks the SANE network protocol like saned does, for every RPC known to
+the dissector, without any scanner or SANE installation. It listens on
+loopback by default, so traffic captured there exercises the dissector
+and its statistics with known timings, statuses and image sizes.
+
+Devices and their options come from a JSON file (--config), or a built-in
+flatbed with an ADF whose options use range, word list and string list
+constraints. A configuration looks like this:
+
+  {"devices": [{"name": "emu:0", "vendor": "Emulated", "model": "Flatbed",
+                "type": "flatbed scanner", "options": [
+      {"name": "resolution", "type": "INT", "unit": "DPI",
+       "constraint": [75, 150, 300], "value": 150},
+      {"name": "tl-x", "type": "FIXED", "unit": "MM",
+       "constraint": {"min": 0, "max": 215.9, "quant": 0}, "value": 0},
+      {"name": "mode", "type": "STRING", "size": 32,
+       "constraint": ["Gray", "Color"], "value": "Gray"}]}]}
+
+Option 0, the number of options, is added automatically. The image
+parameters follow the standard "mode", "depth", "resolution" and
+geometry options when a device has them.
+
+SANE_NET_START opens a data connection that streams a synthetic image,
+optionally limited to --rate bytes per second. Delays, DEVICE_BUSY and
+JAMMED statuses and authorization challenges can be injected.
+
+Usage: sane-emulator.py [options]
+"""
+
+from __future__ import print_function
+
+import hashlib
+import json
+import optparse
+import random
+import socket
+import sys
+import threading
+import time
+
+try:
+    import socketserver
+except ImportError:
+    import SocketServer as socketserver
+
+import saneproto
+
+TYPE_NAMES = {
+    'BOOL': saneproto.SANE_TYPE_BOOL,
+    'INT': saneproto.SANE_TYPE_INT,
+    'FIXED': saneproto.SANE_TYPE_FIXED,
+    'STRING': saneproto.SANE_TYPE_STRING,
+    'BUTTON': saneproto.SANE_TYPE_BUTTON,
+    'GROUP': saneproto.SANE_TYPE_GROUP,
+}
+
+UNIT_NAMES = {
+    'NONE': saneproto.SANE_UNIT_NONE,
+    'PIXEL': saneproto.SANE_UNIT_PIXEL,
+    'BIT': saneproto.SANE_UNIT_BIT,
+    'MM': saneproto.SANE_UNIT_MM,
+    'DPI': saneproto.SANE_UNIT_DPI,
+    'PERCENT': saneproto.SANE_UNIT_PERCENT,
+    'MICROSECOND': saneproto.SANE_UNIT_MICROSECOND,
+}
+
+DEFAULT_CAP = saneproto.SANE_CAP_SOFT_SELECT | saneproto.SANE_CAP_SOFT_DETECT
+
+# options that change the image parameters when set
+PARAMETER_OPTIONS = ('mode', 'depth', 'resolution', 'tl-x', 'tl-y', 'br-x', 'br-y', 'preview')
+
+DEFAULT_DEVICES = [{
+    'name': 'emu:0',
+    'vendor': 'Emulated',
+    'model': 'Flatbed with ADF',
+    'type': 'flatbed scanner',
+    'options': [
+        {'title': 'Standard', 'type': 'GROUP'},
+        {'name': 'mode', 'title': 'Scan mode', 'type': 'STRING', 'size': 32,
+         'constraint': ['Lineart', 'Gray', 'Color'], 'value': 'Gray'},
+        {'name': 'depth', 'title': 'Bit depth', 'type': 'INT', 'unit': 'BIT',
+         'constraint': [8, 16], 'value': 8},
+        {'name': 'resolution', 'title': 'Scan resolution', 'type': 'INT', 'unit': 'DPI',
+         'constraint': [75, 150, 300, 600], 'value': 150},
+        {'name': 'source', 'title': 'Scan source', 'type': 'STRING', 'size': 32,
+         'constraint': ['Flatbed', 'ADF'], 'value': 'Flatbed'},
+        {'name': 'preview', 'title': 'Preview', 'type': 'BOOL', 'value': False},
+        {'title': 'Geometry', 'type': 'GROUP'},
+        {'name': 'tl-x', 'title': 'Top-left x', 'type': 'FIXED', 'unit': 'MM',
+         'constraint': {'min': 0, 'max': 215.9, 'quant': 0}, 'value': 0},
+        {'name': 'tl-y', 'title': 'Top-left y', 'type': 'FIXED', 'unit': 'MM',
+         'constraint': {'min': 0, 'max': 297.0, 'quant': 0}, 'value': 0},
+        {'name': 'br-x', 'title': 'Bottom-right x', 'type': 'FIXED', 'unit': 'MM',
+         'constraint': {'min': 0, 'max': 215.9, 'quant': 0}, 'value': 215.9},
+        {'name': 'br-y', 'title': 'Bottom-right y', 'type': 'FIXED', 'unit': 'MM',
+         'constraint': {'min': 0, 'max': 297.0, 'quant': 0}, 'value': 297.0},
+        {'title': 'Enhancement', 'type': 'GROUP'},
+        {'name': 'brightness', 'title': 'Brightness', 'type': 'INT', 'unit': 'PERCENT',
+         'constraint': {'min': -100, 'max': 100, 'quant': 5}, 'value': 0,
+         'cap': DEFAULT_CAP | saneproto.SANE_CAP_AUTOMATIC},
+        {'name': 'calibrate', 'title': 'Calibrate', 'type': 'BUTTON',
+         'cap': saneproto.SANE_CAP_SOFT_SELECT | saneproto.SANE_CAP_ADVANCED},
+    ],
+}]
+
+
+class ConfigError(Exception):
+    pass
+
+
+class InvalidValue(Exception):
+    pass
+
+
+def lookup(value, names, what):
+    if isinstance(value, int):
+        return value
+    try:
+        return names[value.upper()]
+    except (AttributeError, KeyError):
+        raise ConfigError('unknown %s: %s' % (what, value))
+
+
+def to_word(value, value_type):
+    if value_type == saneproto.SANE_TYPE_FIXED:
+        return saneproto.fix(value)
+    return int(value) & 0xffffffff
+
+
+def signed(word):
+    return word - (1 << 32) if word & 0x80000000 else word
+
+
+class Option(object):
+    """Descriptor and default value of an option, built from its configuration."""
+
+    def __init__(self, config):
+        self.name = config.get('name', '')
+        self.type = lookup(config.get('type', 'INT'), TYPE_NAMES, 'option type')
+        self.unit = lookup(config.get('unit', 'NONE'), UNIT_NAMES, 'unit')
+        self.cap = config.get('cap', 0 if self.type == saneproto.SANE_TYPE_GROUP else DEFAULT_CAP)
+        self.descriptor = {
+            'name': self.name,
+            'title': config.get('title', self.name),
+            'desc': config.get('desc', config.get('title', self.name)),
+            'type': self.type,
+            'unit': self.unit,
+            'cap': self.cap,
+            'constraint_type': saneproto.SANE_CONSTRAINT_NONE,
+            'constraint': None,
+        }
+
+        constraint = config.get('constraint')
+        self.range = None
+        self.words = None
+        self.strings = None
+        if isinstance(constraint, dict):
+            self.range = tuple(to_word(constraint.get(key, 0), self.type) for key in ('min', 'max', 'quant'))
+            self.descriptor['constraint_type'] = saneproto.SANE_CONSTRAINT_RANGE
+            self.descriptor['constraint'] = self.range
+        elif constraint and self.type == saneproto.SANE_TYPE_STRING:
+            self.strings = list(constraint)
+            # NULL terminated on the wire, like the array in the descriptor
+            self.descriptor['constraint_type'] = saneproto.SANE_CONSTRAINT_STRING_LIST
+            self.descriptor['constraint'] = self.strings + [None]
+        elif constraint:
+            self.words = [to_word(word, self.type) for word in constraint]
+            # the first word of a word list is its length
+            self.descriptor['constraint_type'] = saneproto.SANE_CONSTRAINT_WORD_LIST
+            self.descriptor['constraint'] = [len(self.words)] + self.words
+
+        if self.type == saneproto.SANE_TYPE_STRING:
+            self.size = config.get('size', max([len(s) for s in self.strings or ()] + [31]) + 1)
+            self.default = config.get('value', self.strings[0] if self.strings else '')
+        elif self.type in (saneproto.SANE_TYPE_BUTTON, saneproto.SANE_TYPE_GROUP):
+            self.size = 0
+            self.default = None
+        else:
+            self.size = 4
+            value = config.get('value', 0)
+            self.default = [to_word(value, self.type)]
+        self.descriptor['size'] = self.size
+
+    def encode(self, value):
+        if self.type == saneproto.SANE_TYPE_STRING:
+            data = value.encode('utf-8')[:self.size - 1]
+            return data + b'\0' * (self.size - len(data))
+        if value is None:
+            return b''
+        return b''.join(saneproto.pack_word(word) for word in value)
+
+    def decode(self, data):
+        if self.type == saneproto.SANE_TYPE_STRING:
+            return data.split(b'\0', 1)[0].decode('utf-8', 'replace')
+        if len(data) != self.size:
+            raise InvalidValue('%s: expected %d bytes, got %d' % (self.name, self.size, len(data)))
+        return [saneproto.WORD.unpack_from(data, offset)[0] for offset in range(0, len(data), 4)]
+
+    def constrain(self, value):
+        """Value as the device would store it, and whether it had to be changed."""
+        if self.type == saneproto.SANE_TYPE_STRING:
+            if self.strings is None:
+                return value, False
+            for string in self.strings:
+                if string.lower() == value.lower():
+                    return string, string != value
+            raise InvalidValue('%s: %s is not one of %s' % (self.name, value, ', '.join(self.strings)))
+
+        if self.type == saneproto.SANE_TYPE_BOOL:
+            if any(word > 1 for word in value):
+                raise InvalidValue('%s: not a boolean' % self.name)
+            return value, False
+
+        constrained = []
+        for word in value:
+            word = signed(word)
+            if self.range:
+                low, high, quant = [signed(bound) for bound in self.range]
+                word = min(max(word, low), high)
+                if quant:
+                    word = low + int(round(float(word - low) / quant)) * quant
+            elif self.words:
+                word = min((signed(allowed) for allowed in self.words), key=lambda allowed: abs(allowed - word))
+            constrained.append(word & 0xffffffff)
+        return constrained, constrained != value
+
+
+class Device(object):
+    def __init__(self, config):
+        self.name = config['name']
+        self.info = (self.name, config.get('vendor', 'Emulated'), config.get('model', 'Scanner'),
+                     config.get('type', 'virtual device'))
+        count = Option({'title': 'Number of options', 'type': 'INT',
+                        'cap': saneproto.SANE_CAP_SOFT_DETECT})
+        self.options = [count] + [Option(option) for option in config.get('options', ())]
+        count.default = [len(self.options)]
+        self.backend = self.name.split(':')[0]
+
+
+def load_devices(path):
+    if not path:
+        return [Device(config) for config in DEFAULT_DEVICES]
+    try:
+        with open(path) as f:
+            config = json.load(f)
+        return [Device(device) for device in config['devices']]
+    except (IOError, ValueError, KeyError, TypeError) as error:
+        raise ConfigError('%s: %s' % (path, error))
+
+
+class OpenDevice(object):
+    """Option values and scan state of a handle."""
+
+    def __init__(self, device):
+        self.device = device
+        self.values = [option.default for option in device.options]
+        self.inactive = set()
+        self.pages = 0
+        self.cancel = threading.Event()
+
+    def descriptors(self):
+        descriptors = []
+        for number, option in enumerate(self.device.options):
+            descriptor = option.descriptor
+            if number in self.inactive:
+                descriptor = dict(descriptor, cap=descriptor['cap'] | saneproto.SANE_CAP_INACTIVE)
+            descriptors.append(descriptor)
+        return descriptors
+
+    def option(self, name):
+        for option, value in zip(self.device.options, self.values):
+            if option.name == name:
+                return option, value
+        return None, None
+
+    def number(self, name, default):
+        option, value = self.option(name)
+        if option is None or not value:
+            return default
+        if option.type == saneproto.SANE_TYPE_FIXED:
+            return saneproto.unfix(value[0])
+        return signed(value[0])
+
+    def string(self, name, default):
+        option, value = self.option(name)
+        return value if option is not None and option.type == saneproto.SANE_TYPE_STRING else default
+
+    def parameters(self):
+        mode = self.string('mode', 'Gray').lower()
+        depth = 1 if mode == 'lineart' else self.number('depth', 8)
+        resolution = self.number('resolution', 150)
+        if self.number('preview', 0):
+            resolution = min(resolution, 75)
+        width = max(0.0, self.number('br-x', 215.9) - self.number('tl-x', 0.0))
+        height = max(0.0, self.number('br-y', 297.0) - self.number('tl-y', 0.0))
+
+        pixels = max(1, int(width / 25.4 * resolution))
+        lines = max(1, int(height / 25.4 * resolution))
+        channels = 3 if mode == 'color' else 1
+        bytes_per_line = (pixels * channels * depth + 7) // 8
+        frame = saneproto.SANE_FRAME_RGB if channels == 3 else saneproto.SANE_FRAME_GRAY
+
+        # format, last frame, bytes per line, pixels per line, lines, depth
+        return (frame, 1, bytes_per_line, pixels, lines, depth)
+
+
+class Faults(object):
+    """Delays, statuses and challenges injected into the replies."""
+
+    def __init__(self, options):
+        self.delays = {}
+        for delay in options.delay or ():
+            name, _, msec = delay.rpartition('=')
+            self.delays[self.rpc(name) if name else None] = float(msec) / 1000.0
+        self.jitter = options.jitter / 1000.0
+        self.busy = options.busy
+        self.jammed = options.jammed
+        self.adf_pages = options.adf_pages
+        self.authorize = options.authorize
+        self.md5 = options.md5
+        self.username, _, self.password = options.user.partition(':')
+        self.random = random.Random(options.seed)
+        self.lock = threading.Lock()
+
+    @staticmethod
+    def rpc(name):
+        for code, code_name in saneproto.CODE_NAMES.items():
+            if name.upper() in (code_name, code_name[len('SANE_NET_'):]):
+                return code
+        raise ConfigError('unknown RPC: %s' % name)
+
+    def chance(self, probability):
+        with self.lock:
+            return self.random.random() < probability
+
+    def delay(self, rpc):
+        seconds = self.delays.get(rpc, self.delays.get(None, 0.0))
+        if self.jitter:
+            with self.lock:
+                seconds += self.random.uniform(0, self.jitter)
+        if seconds > 0:
+            time.sleep(seconds)
+
+    def salt(self):
+        with self.lock:
+            return '%08x' % self.random.getrandbits(32)
+
+
+class ControlHandler(socketserver.BaseRequestHandler):
+    """One client connection, served like saned serves it."""
+
+    def setup(self):
+        self.wire = saneproto.Wire(self.request)
+        self.version = saneproto.SANE_NET_PROTOCOL_VERSION
+        self.handles = {}
+        self.next_handle = 0
+
+    def log(self, message):
+        if self.server.verbose:
+            print('%s:%d: %s' % (self.client_address[0], self.client_address[1], message), file=sys.stderr)
+
+    def handle(self):
+        try:
+            while True:
+                rpc, request = self.wire.read_request(self.version)
+                self.log(saneproto.code_name(rpc))
+                self.server.faults.delay(rpc)
+                if rpc == saneproto.SANE_NET_EXIT:
+                    break
+                reply = self.dispatch(rpc, request)
+                if reply is not None:
+                    self.wire.send(saneproto.pack_reply(rpc, **reply))
+        except (socket.error, saneproto.ProtocolError) as error:
+            self.log(str(error))
+        finally:
+            for open_device in self.handles.values():
+                open_device.cancel.set()
+
+    def dispatch(self, rpc, request):
+        if rpc == saneproto.SANE_NET_INIT:
+            self.version = request['version_code'] & 0xffff
+            return {'version_code': saneproto.version_code(1, 0, saneproto.SANE_NET_PROTOCOL_VERSION)}
+        if rpc == saneproto.SANE_NET_GET_DEVICES:
+            # NULL terminated, like the array returned by sane_get_devices()
+            return {'devices': [device.info for device in self.server.devices] + [None]}
+        if rpc == saneproto.SANE_NET_OPEN:
+            return self.open(request['device'])
+        if rpc == saneproto.SANE_NET_AUTHORIZE:
+            # only expected while a reply waits for it
+            return {}
+
+        open_device = self.handles.get(request['handle'])
+        if rpc == saneproto.SANE_NET_CLOSE:
+            if open_device:
+                open_device.cancel.set()
+                del self.handles[request['handle']]
+            return {}
+        if rpc == saneproto.SANE_NET_CANCEL:
+            if open_device:
+                open_device.cancel.set()
+            return {}
+        if not open_device:
+            if rpc == saneproto.SANE_NET_GET_OPTION_DESCRIPTORS:
+                return {'options': ()}
+            return {'status': saneproto.SANE_STATUS_INVAL}
+        if rpc == saneproto.SANE_NET_GET_OPTION_DESCRIPTORS:
+            return {'options': open_device.descriptors()}
+        if rpc == saneproto.SANE_NET_CONTROL_OPTION:
+            return self.control_option(open_device, request)
+        if rpc == saneproto.SANE_NET_GET_PARAMETERS:
+            return {'parameters': open_device.parameters()}
+        if rpc == saneproto.SANE_NET_START:
+            return self.start(open_device)
+        return None
+
+    def challenge(self, rpc, backend):
+        """Ask the client to authorize, as saned does before sending the actual reply."""
+        faults = self.server.faults
+        salt = faults.salt() if faults.md5 else None
+        resource = backend + '$MD5$' + salt if salt else backend
+        self.wire.send(saneproto.pack_reply(rpc, resource=resource))
+
+        authorize, request = self.wire.read_request(self.version)
+        if authorize != saneproto.SANE_NET_AUTHORIZE:
+            raise saneproto.ProtocolError('expected SANE_NET_AUTHORIZE, got %s' % saneproto.code_name(authorize))
+        self.wire.send(saneproto.pack_reply(saneproto.SANE_NET_AUTHORIZE))
+
+        password = faults.password
+        if salt:
+            password = '$MD5$' + hashlib.md5((salt + password).encode('utf-8')).hexdigest()
+        granted = request['username'] == faults.username and request['password'] == password
+        self.log('authorization of %s for %s %s' % (resource, request['username'],
+                                                     'granted' if granted else 'denied'))
+        return granted
+
+    def open(self, name):
+        faults = self.server.faults
+        device = None
+        for candidate in self.server.devices:
+            if not name or candidate.name == name:
+                device = candidate
+                break
+        if not device:
+            return {'status': saneproto.SANE_STATUS_INVAL}
+
+        if faults.authorize and not self.challenge(saneproto.SANE_NET_OPEN, device.backend):
+            return {'status': saneproto.SANE_STATUS_ACCESS_DENIED}
+        if faults.chance(faults.busy):
+            return {'status': saneproto.SANE_STATUS_DEVICE_BUSY}
+
+        handle = self.next_handle
+        self.next_handle += 1
+        self.handles[handle] = OpenDevice(device)
+        return {'handle': handle}
+
+    def control_option(self, open_device, request):
+        options = open_device.device.options
+        number = request['option']
+        if number >= len(options):
+            return {'status': saneproto.SANE_STATUS_INVAL}
+        option = options[number]
+
+        info = 0
+        action = request['action']
+        if action != saneproto.SANE_ACTION_GET_VALUE:
+            if number == 0 or not option.cap & saneproto.SANE_CAP_SOFT_SELECT or number in open_device.inactive:
+                return {'status': saneproto.SANE_STATUS_INVAL}
+            try:
+                if action == saneproto.SANE_ACTION_SET_AUTO:
+                    if not option.cap & saneproto.SANE_CAP_AUTOMATIC:
+                        return {'status': saneproto.SANE_STATUS_INVAL}
+                    value = option.default
+                elif action == saneproto.SANE_ACTION_SET_VALUE:
+                    if request.get('value_type') != option.type:
+                        return {'status': saneproto.SANE_STATUS_INVAL}
+                    value, inexact = option.constrain(option.decode(request['value']))
+                    if inexact:
+                        info |= saneproto.SANE_INFO_INEXACT
+                else:
+                    return {'status': saneproto.SANE_STATUS_INVAL}
+            except InvalidValue as error:
+                self.log(str(error))
+                return {'status': saneproto.SANE_STATUS_INVAL}
+
+            if option.type != saneproto.SANE_TYPE_BUTTON:
+                if option.name in PARAMETER_OPTIONS and value != open_device.values[number]:
+                    info |= saneproto.SANE_INFO_RELOAD_PARAMS
+                if option.name == 'mode' and value != open_device.values[number]:
+                    # the bit depth does not apply to line art
+                    info |= saneproto.SANE_INFO_RELOAD_OPTIONS
+                    self.update_depth(open_device, value)
+                open_device.values[number] = value
+
+        return {'info': info, 'value_type': option.type, 'value_size': option.size,
+                'value': option.encode(open_device.values[number])}
+
+    def update_depth(self, open_device, mode):
+        for number, option in enumerate(open_device.device.options):
+            if option.name == 'depth':
+                if mode.lower() == 'lineart':
+                    open_device.inactive.add(number)
+                else:
+                    open_device.inactive.discard(number)
+
+    def start(self, open_device):
+        faults = self.server.faults
+        if faults.authorize and not self.challenge(saneproto.SANE_NET_START, open_device.device.backend):
+            return {'status': saneproto.SANE_STATUS_ACCESS_DENIED}
+        if faults.chance(faults.busy):
+            return {'status': saneproto.SANE_STATUS_DEVICE_BUSY}
+        if faults.chance(faults.jammed):
+            return {'status': saneproto.SANE_STATUS_JAMMED}
+        if open_device.string('source', '').lower() == 'adf':
+            if open_device.pages >= faults.adf_pages:
+                open_device.pages = 0
+                return {'status': saneproto.SANE_STATUS_NO_DOCS}
+            open_device.pages += 1
+
+        listener = socket.socket(self.server.address_family, socket.SOCK_STREAM)
+        listener.bind((self.server.server_address[0], 0))
+        listener.listen(1)
+        listener.settimeout(self.server.data_timeout)
+
+        open_device.cancel = threading.Event()
+        sender = threading.Thread(target=self.server.send_image,
+                                  args=(listener, open_device.parameters(), open_device.cancel))
+        sender.daemon = True
+        sender.start()
+
+        return {'port': listener.getsockname()[1], 'byte_order': 0x1234}
+
+
+class Emulator(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+    def __init__(self, address, devices, faults, options):
+        if ':' in address[0]:
+            self.address_family = socket.AF_INET6
+        socketserver.TCPServer.__init__(self, address, ControlHandler)
+        self.devices = devices
+        self.faults = faults
+        self.rate = options.rate
+        self.record_size = options.record_size
+        self.data_timeout = options.timeout
+        self.verbose = options.verbose
+
+    def send_image(self, listener, parameters, cancel):
+        """Stream a synthetic image of the given parameters to the data connection."""
+        try:
+            sock, _ = listener.accept()
+        except socket.error:
+            return
+        finally:
+            listener.close()
+
+        bytes_per_line, lines = parameters[2], parameters[4]
+        total = bytes_per_line * lines
+        pattern = bytes(bytearray(range(256))) * (self.record_size // 256 + 2)
+        started = time.time()
+        sent = 0
+        try:
+            while sent < total and not cancel.is_set():
+                size = min(self.record_size, total - sent)
+                offset = (sent // bytes_per_line) % 256
+                sock.sendall(saneproto.pack_record(pattern[offset:offset + size]))
+                sent += size
+                if self.rate:
+                    ahead = float(sent) / self.rate - (time.time() - started)
+                    if ahead > 0:
+                        time.sleep(ahead)
+            status = saneproto.SANE_STATUS_CANCELLED if cancel.is_set() else saneproto.SANE_STATUS_EOF
+            sock.sendall(saneproto.pack_end_of_records(status))
+        except socket.error:
+            pass
+        finally:
+            sock.close()
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options]')
+    parser.add_option('-l', '--listen', default='127.0.0.1',
+                      help='address to listen on [default: %default]')
+    parser.add_option('-p', '--port', type='int', default=saneproto.TCP_PORT_SANE,
+                      help='control port [default: %default]')
+    parser.add_option('--config', metavar='FILE',
+                      help='JSON file with the devices and their options')
+    parser.add_option('--rate', type='int', default=0, metavar='BYTES',
+                      help='image data bytes per second per scan, 0 for unlimited [default: %default]')
+    parser.add_option('--record-size', type='int', default=32768, metavar='BYTES',
+                      help='size of the image data records [default: %default]')
+    parser.add_option('--delay', action='append', metavar='[RPC=]MSEC',
+                      help='delay the replies to RPC, or all RPCs, may be repeated')
+    parser.add_option('--jitter', type='float', default=0.0, metavar='MSEC',
+                      help='add up to this random delay to every reply [default: %default]')
+    parser.add_option('--busy', type='float', default=0.0, metavar='P',
+                      help='answer OPEN and START with DEVICE_BUSY with this probability')
+    parser.add_option('--jammed', type='float', default=0.0, metavar='P',
+                      help='answer START with JAMMED with this probability')
+    parser.add_option('--adf-pages', type='int', default=3, metavar='N',
+                      help='pages in the ADF before START reports NO_DOCS [default: %default]')
+    parser.add_option('--authorize', action='store_true', default=False,
+                      help='ask for authorization on OPEN and START')
+    parser.add_option('--md5', action='store_true', default=False,
+                      help='ask for MD5 hashed passwords when authorizing')
+    parser.add_option('--user', default='sane:sane', metavar='NAME:PASSWORD',
+                      help='credentials accepted when authorizing [default: %default]')
+    parser.add_option('--seed', type='int', help='seed for the injected faults')
+    parser.add_option('--timeout', type='float', default=30.0,
+                      help='seconds to wait for the data connection [default: %default]')
+    parser.add_option('-v', '--verbose', action='store_true', default=False,
+                      help='log every request')
+    options, args = parser.parse_args()
+    if args:
+        parser.error('unexpected arguments')
+    if options.record_size <= 0:
+        parser.error('--record-size must be positive')
+
+    try:
+        devices = load_devices(options.config)
+        faults = Faults(options)
+        server = Emulator((options.listen, options.port), devices, faults, options)
+    except (ConfigError, ValueError, socket.error) as error:
+        print('sane-emulator.py: %s' % error, file=sys.stderr)
+        return 1
+
+    print('sane-emulator.py: %s on %s port %d' % (', '.join(device.name for device in devices),
+                                                  options.listen, server.server_address[1]), file=sys.stderr)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.server_close()
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
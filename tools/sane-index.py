@@ -0,0 +1,372 @@
+#!/usr/bin/env python
+# sane-index.py
+# Build and query a sidecar index of the SANE transactions of a capture file
+#
+# Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+"""
+Pairing the replies of a SANE control connection with their requests takes
+a full pass over the capture. This tool does that pass once with tshark and
+stores the result next to the capture file (CAPTURE.saneidx by default):
+a header carrying the size and SHA-256 of the capture, followed by one
+fixed-size record per SANE request or reply, sorted by frame number.
+
+Queries memory-map the index, check it still belongs to the capture by its
+size and a hash of its first and last MiB, or by the SHA-256 of all of it
+with --verify, and print the matching frames, either as a list, as a display filter or as
+frame ranges for "editcap -r", so that only the frames of interest need to
+be opened or dissected again.
+
+Usage: sane-index.py build [options] CAPTURE
+       sane-index.py query [options] CAPTURE
+"""
+
+from __future__ import print_function
+
+import bisect
+import hashlib
+import mmap
+import optparse
+import os
+import struct
+import sys
+import tempfile
+
+import saneproto
+
+MAGIC = b'SANEIDX\0'
+VERSION = 2
+
+# magic, version, record size, record count, reserved, capture size,
+# SHA-256 of the first and last chunk of the capture, SHA-256 of the capture
+HEADER = struct.Struct('>8sIIIIQ32s32s')
+
+# frame, tcp stream, RPC code, matched frame, handle, status, flags
+RECORD = struct.Struct('>IIIIIII')
+
+FLAG_REQUEST = 0x1
+FLAG_HAVE_STATUS = 0x2
+FLAG_HAVE_HANDLE = 0x4
+FLAG_MATCHED = 0x8
+
+FRAME_FIELDS = (
+    'frame.number',
+    'tcp.stream',
+)
+
+PDU_FIELDS = (
+    'sane.rpc.code',
+    'sane.rpc.status',
+    'sane.response_in',
+    'sane.response_to',
+    'sane.net.handle',
+)
+
+HASH_CHUNK_SIZE = 1024 * 1024
+
+
+class IndexFileError(Exception):
+    pass
+
+
+def capture_digest(capture):
+    digest = hashlib.sha256()
+    with open(capture, 'rb') as f:
+        while True:
+            chunk = f.read(HASH_CHUNK_SIZE)
+            if not chunk:
+                break
+            digest.update(chunk)
+    return digest.digest()
+
+
+def capture_quick_digest(capture):
+    """SHA-256 of the first and last chunk of the capture, cheap enough for every query."""
+    digest = hashlib.sha256()
+    with open(capture, 'rb') as f:
+        digest.update(f.read(HASH_CHUNK_SIZE))
+        f.seek(0, os.SEEK_END)
+        if f.tell() > HASH_CHUNK_SIZE:
+            f.seek(max(HASH_CHUNK_SIZE, f.tell() - HASH_CHUNK_SIZE))
+            digest.update(f.read(HASH_CHUNK_SIZE))
+    return digest.digest()
+
+
+def to_int(value):
+    if not value:
+        return None
+    return int(value, 0)
+
+
+def read_transactions(tshark, capture):
+    """Run tshark over the capture and return the index records, sorted by frame."""
+    records = []
+    requests = {}
+    try:
+        for row in saneproto.tshark_pdus(tshark, capture, 'sane.rpc.code', FRAME_FIELDS, PDU_FIELDS):
+            frame = int(row['frame.number'])
+            rpc = to_int(row['sane.rpc.code'])
+            if rpc is None:
+                continue
+            request = not row['sane.response_to']
+            status = to_int(row['sane.rpc.status'])
+            handle = to_int(row['sane.net.handle'])
+
+            flags = 0
+            if request:
+                flags |= FLAG_REQUEST
+                matched = to_int(row['sane.response_in'])
+            else:
+                matched = to_int(row['sane.response_to'])
+            if matched is not None:
+                flags |= FLAG_MATCHED
+            if status is not None:
+                flags |= FLAG_HAVE_STATUS
+            if handle is not None:
+                flags |= FLAG_HAVE_HANDLE
+
+            record = [frame, int(row['tcp.stream'] or 0), rpc,
+                      matched or 0, handle or 0, status or 0, flags]
+            records.append(record)
+            # a frame may carry several requests, a reply carries the code of its own
+            if request:
+                requests.setdefault((frame, rpc), record)
+    except saneproto.TsharkError as error:
+        raise IndexFileError(str(error))
+
+    # replies only carry a handle for SANE_NET_OPEN, take it from the request
+    for record in records:
+        if record[6] & (FLAG_REQUEST | FLAG_HAVE_HANDLE | FLAG_MATCHED) != FLAG_MATCHED:
+            continue
+        request = requests.get((record[3], record[2]))
+        if request and request[6] & FLAG_HAVE_HANDLE:
+            record[4] = request[4]
+            record[6] |= FLAG_HAVE_HANDLE
+
+    # the PDUs of a frame keep their order
+    records.sort(key=lambda record: record[0])
+    return records
+
+
+def build_index(tshark, capture, index):
+    records = read_transactions(tshark, capture)
+    header = HEADER.pack(MAGIC, VERSION, RECORD.size, len(records), 0,
+                         os.path.getsize(capture), capture_quick_digest(capture),
+                         capture_digest(capture))
+
+    # write to a temporary file first, so a failed run never leaves a broken index behind
+    directory = os.path.dirname(os.path.abspath(index))
+    fd, temporary = tempfile.mkstemp(prefix='.saneidx', dir=directory)
+    try:
+        with os.fdopen(fd, 'wb') as out:
+            out.write(header)
+            for record in records:
+                out.write(RECORD.pack(*record))
+        os.rename(temporary, index)
+    except:
+        os.unlink(temporary)
+        raise
+
+    return len(records)
+
+
+class Index(object):
+    """Memory-mapped, read-only view of an index file."""
+
+    def __init__(self, index):
+        self.file = open(index, 'rb')
+        size = os.fstat(self.file.fileno()).st_size
+        if size < HEADER.size:
+            raise IndexFileError('%s: not a SANE index' % index)
+
+        self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, record_size, self.count, _,
+         self.capture_size, self.quick_digest, self.digest) = HEADER.unpack_from(self.map, 0)
+        if magic != MAGIC:
+            raise IndexFileError('%s: not a SANE index' % index)
+        if version != VERSION or record_size != RECORD.size:
+            raise IndexFileError('%s: unsupported index version %d, rebuild it' % (index, version))
+        if size != HEADER.size + self.count * RECORD.size:
+            raise IndexFileError('%s: truncated index' % index)
+
+    def close(self):
+        self.map.close()
+        self.file.close()
+
+    def __len__(self):
+        return self.count
+
+    def __getitem__(self, position):
+        if position < 0 or position >= self.count:
+            raise IndexError('record %d out of range' % position)
+        return RECORD.unpack_from(self.map, HEADER.size + position * RECORD.size)
+
+    def frame_at(self, position):
+        return self[position][0]
+
+    def check(self, capture, verify=False):
+        """Whether the index belongs to the capture, by all of its content with verify."""
+        if (os.path.getsize(capture) != self.capture_size or
+                capture_quick_digest(capture) != self.quick_digest or
+                (verify and capture_digest(capture) != self.digest)):
+            raise IndexFileError('index does not belong to %s, rebuild it' % capture)
+
+    def find(self, first_frame):
+        """Position of the first record at or after the given frame."""
+        return bisect.bisect_left(FrameView(self), first_frame)
+
+
+class FrameView(object):
+    """Sequence of the frame numbers of an index, for bisect."""
+
+    def __init__(self, index):
+        self.index = index
+
+    def __len__(self):
+        return len(self.index)
+
+    def __getitem__(self, position):
+        return self.index.frame_at(position)
+
+
+def lookup_name(value, names, what):
+    if value is None:
+        return None
+    for code, name in names.items():
+        if value.upper() in (name, name.split('_', 2)[-1]):
+            return code
+    try:
+        return int(value, 0)
+    except ValueError:
+        raise IndexFileError('unknown %s: %s' % (what, value))
+
+
+def query_index(index, options):
+    rpc = lookup_name(options.rpc, saneproto.CODE_NAMES, 'RPC')
+    status = lookup_name(options.status, saneproto.STATUS_NAMES, 'status')
+
+    frames = set()
+    position = index.find(options.first or 0)
+    while position < len(index):
+        frame, stream, code, matched, handle, reply_status, flags = index[position]
+        position += 1
+
+        if options.last and frame > options.last:
+            break
+        if options.stream is not None and stream != options.stream:
+            continue
+        if rpc is not None and code != rpc:
+            continue
+        if options.handle is not None and (not flags & FLAG_HAVE_HANDLE or handle != options.handle):
+            continue
+        if status is not None and (not flags & FLAG_HAVE_STATUS or reply_status != status):
+            continue
+        if options.errors and (not flags & FLAG_HAVE_STATUS or reply_status == saneproto.SANE_STATUS_GOOD):
+            continue
+        if options.unmatched and flags & FLAG_MATCHED:
+            continue
+
+        frames.add(frame)
+        if options.pairs and flags & FLAG_MATCHED:
+            frames.add(matched)
+
+    return sorted(frames)
+
+
+def frame_ranges(frames):
+    ranges = []
+    for frame in frames:
+        if ranges and ranges[-1][1] + 1 == frame:
+            ranges[-1][1] = frame
+        else:
+            ranges.append([frame, frame])
+    return ranges
+
+
+def print_frames(frames, output_format, out=sys.stdout):
+    if output_format == 'frames':
+        for frame in frames:
+            print(frame, file=out)
+    elif output_format == 'filter':
+        terms = []
+        for first, last in frame_ranges(frames):
+            if first == last:
+                terms.append('frame.number == %d' % first)
+            else:
+                terms.append('(frame.number >= %d && frame.number <= %d)' % (first, last))
+        print(' || '.join(terms), file=out)
+    elif output_format == 'editcap':
+        print(' '.join('%d' % first if first == last else '%d-%d' % (first, last)
+                       for first, last in frame_ranges(frames)), file=out)
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog build|query [options] CAPTURE')
+    parser.add_option('-i', '--index', metavar='FILE',
+                      help='index file [default: CAPTURE.saneidx]')
+    parser.add_option('--tshark', default='tshark',
+                      help='build: tshark binary to use [default: %default]')
+    parser.add_option('--rpc', metavar='NAME',
+                      help='query: only this RPC, e.g. SANE_NET_START or START')
+    parser.add_option('--status', metavar='NAME',
+                      help='query: only replies with this status, e.g. DEVICE_BUSY')
+    parser.add_option('--errors', action='store_true', default=False,
+                      help='query: only replies with a status other than SANE_STATUS_GOOD')
+    parser.add_option('--unmatched', action='store_true', default=False,
+                      help='query: only requests without reply and replies without request')
+    parser.add_option('--stream', type='int', metavar='N',
+                      help='query: only this TCP stream')
+    parser.add_option('--handle', type='int', metavar='N',
+                      help='query: only this device handle')
+    parser.add_option('--first', type='int', metavar='FRAME',
+                      help='query: start at this frame')
+    parser.add_option('--last', type='int', metavar='FRAME',
+                      help='query: stop at this frame')
+    parser.add_option('--pairs', action='store_true', default=False,
+                      help='query: also print the matching request or reply')
+    parser.add_option('--verify', action='store_true', default=False,
+                      help='query: check the index against a hash of the whole capture')
+    parser.add_option('-f', '--format', choices=('frames', 'filter', 'editcap'), default='frames',
+                      help='query: print frame numbers, a display filter or editcap ranges [default: %default]')
+    options, args = parser.parse_args()
+    if len(args) != 2 or args[0] not in ('build', 'query'):
+        parser.error('expected build or query and a capture file')
+
+    command, capture = args
+    index_file = options.index or capture + '.saneidx'
+
+    try:
+        if command == 'build':
+            count = build_index(options.tshark, capture, index_file)
+            print('%s: %d SANE requests and replies indexed' % (index_file, count), file=sys.stderr)
+            return 0
+
+        index = Index(index_file)
+        try:
+            index.check(capture, options.verify)
+            print_frames(query_index(index, options), options.format)
+        finally:
+            index.close()
+    except (IOError, OSError, IndexFileError) as error:
+        print('sane-index.py: %s' % error, file=sys.stderr)
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,452 @@
+#!/usr/bin/env python
+# sane-replay.py
+# Replay the client side of the SANE sessions of a capture against saned
+#
+# Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+"""
+Extracts the requests of every SANE control connection of a capture with
+tshark and the SANE plugin, and sends them again to a live saned, e.g. one
+running the "test" backend. Each captured connection becomes one replayed
+session with its own connections, so several of them can run at once.
+
+Handles are mapped from the captured to the live SANE_NET_OPEN replies,
+image data announced by SANE_NET_START is read from the data connection
+and authorization requests of the server are answered with the
+credentials of the captured SANE_NET_AUTHORIZE requests or the command
+line. By default sessions start at their offset in the capture and keep
+the client's pauses between a reply and the next request, both scaled by
+--speed, which reproduces the load shape of the capture.
+
+The report lists the response time per RPC, the statuses other than
+SANE_STATUS_GOOD and the throughput of the image data connections.
+
+Usage: sane-replay.py [options] CAPTURE HOST[:PORT]
+"""
+
+from __future__ import print_function
+
+import hashlib
+import optparse
+import socket
+import sys
+import threading
+import time
+
+try:
+    import queue
+except ImportError:
+    import Queue as queue
+
+import saneproto
+
+FRAME_FIELDS = (
+    'frame.number',
+    'frame.time_relative',
+    'tcp.stream',
+)
+
+PDU_FIELDS = (
+    'sane.rpc.code',
+    'sane.response_to',
+    'sane.net.version_code',
+    'sane.net.user_name',
+    'sane.net.device.name',
+    'sane.net.handle',
+    'sane.net.option_num',
+    'sane.net.action',
+    'sane.net.value_type',
+    'sane.net.value_size',
+    'sane.net.value',
+    'sane.net.resource',
+    'sane.net.username',
+    'sane.net.password',
+)
+
+# replies that may ask for authorization first, see sanei_w_reply() users in saned
+AUTHORIZED_RPCS = (
+    saneproto.SANE_NET_OPEN,
+    saneproto.SANE_NET_CONTROL_OPTION,
+    saneproto.SANE_NET_START,
+)
+
+
+class ReplayError(Exception):
+    pass
+
+
+def to_int(value):
+    if not value:
+        return None
+    return int(value, 0)
+
+
+def to_bytes(value):
+    """FT_BYTES fields are printed as colon separated hex digits."""
+    if not value:
+        return b''
+    return bytes(bytearray(int(digit, 16) for digit in value.split(':')))
+
+
+class Script(object):
+    """Requests of one captured control connection, in the order they were sent."""
+
+    def __init__(self, stream, start):
+        self.stream = stream
+        self.start = start
+        self.steps = []
+        self.credentials = {}
+        self.version = saneproto.SANE_NET_PROTOCOL_VERSION
+
+
+def read_scripts(tshark, capture):
+    """Run tshark over the capture and return one script per control connection."""
+    scripts = {}
+    requests = {}
+    try:
+        for row in saneproto.tshark_pdus(tshark, capture, 'sane.rpc.code', FRAME_FIELDS, PDU_FIELDS):
+            frame = int(row['frame.number'])
+            timestamp = float(row['frame.time_relative'])
+            stream = row['tcp.stream']
+            rpc = to_int(row['sane.rpc.code'])
+            if rpc is None:
+                continue
+
+            if row['sane.response_to']:
+                if row['sane.net.resource']:
+                    # asks for authorization, the actual reply follows later
+                    continue
+                # replies answer the requests of a frame in order
+                pending = requests.get((int(row['sane.response_to']), rpc))
+                step = pending.pop(0) if pending else None
+                if step:
+                    step['reply_time'] = timestamp
+                    if rpc == saneproto.SANE_NET_OPEN:
+                        step['captured_handle'] = to_int(row['sane.net.handle'])
+                continue
+
+            script = scripts.get(stream)
+            if not script:
+                script = scripts[stream] = Script(stream, timestamp)
+
+            if rpc == saneproto.SANE_NET_AUTHORIZE:
+                # answered whenever the live server asks, not replayed as is
+                script.credentials[row['sane.net.resource']] = (row['sane.net.username'],
+                                                                row['sane.net.password'])
+                continue
+
+            fields = {}
+            if rpc == saneproto.SANE_NET_INIT:
+                fields['version_code'] = to_int(row['sane.net.version_code'])
+                fields['user_name'] = row['sane.net.user_name'] or None
+                if fields['version_code'] is not None:
+                    script.version = fields['version_code'] & 0xffff
+            elif rpc == saneproto.SANE_NET_OPEN:
+                fields['device'] = row['sane.net.device.name']
+            elif rpc == saneproto.SANE_NET_CONTROL_OPTION:
+                fields['option'] = to_int(row['sane.net.option_num'])
+                fields['action'] = to_int(row['sane.net.action'])
+                if row['sane.net.value_type']:
+                    fields['value_type'] = to_int(row['sane.net.value_type'])
+                    fields['value_size'] = to_int(row['sane.net.value_size'])
+                    fields['value'] = to_bytes(row['sane.net.value'])
+            if row['sane.net.handle']:
+                fields['handle'] = to_int(row['sane.net.handle'])
+
+            step = {'rpc': rpc, 'fields': fields, 'time': timestamp, 'reply_time': None}
+            script.steps.append(step)
+            requests.setdefault((frame, rpc), []).append(step)
+    except saneproto.TsharkError as error:
+        raise ReplayError(str(error))
+
+    # pause of the client between the previous reply and each request
+    for script in scripts.values():
+        previous = script.start
+        for step in script.steps:
+            step['think'] = max(0.0, step['time'] - previous)
+            previous = step['reply_time'] if step['reply_time'] is not None else step['time']
+
+    return sorted(scripts.values(), key=lambda script: script.start)
+
+
+def new_result():
+    return {
+        'sessions': 0,
+        'failed': [],
+        'latency': {},
+        'statuses': {},
+        'transfers': [],
+    }
+
+
+class Session(object):
+    """Replays one script on its own control connection."""
+
+    def __init__(self, script, options):
+        self.script = script
+        self.options = options
+        self.handles = {}
+        self.result = new_result()
+        self.result['sessions'] = 1
+
+    def connect(self, port):
+        return socket.create_connection((self.options.host, port), self.options.timeout)
+
+    def sleep(self, seconds):
+        if self.options.speed > 0 and seconds > 0:
+            time.sleep(seconds / self.options.speed)
+
+    def run(self):
+        try:
+            sock = self.connect(self.options.port)
+        except socket.error as error:
+            self.fail('connect: %s' % error)
+            return self.result
+
+        wire = saneproto.Wire(sock)
+        try:
+            for step in self.script.steps:
+                if self.options.think:
+                    self.sleep(step['think'])
+                self.transact(wire, step)
+        except (socket.error, saneproto.ProtocolError, ReplayError) as error:
+            self.fail(str(error))
+        finally:
+            sock.close()
+
+        return self.result
+
+    def fail(self, error):
+        self.result['failed'].append((self.script.stream, error))
+
+    def transact(self, wire, step):
+        rpc = step['rpc']
+        fields = dict(step['fields'])
+        if 'handle' in fields:
+            fields['handle'] = self.handles.get(fields['handle'], fields['handle'])
+
+        started = time.time()
+        wire.send(saneproto.pack_request(rpc, self.script.version, **fields))
+        if not saneproto.has_reply(rpc):
+            return
+
+        reply = wire.read_reply(rpc)
+        while rpc in AUTHORIZED_RPCS and reply.get('resource'):
+            self.authorize(wire, reply['resource'])
+            reply = wire.read_reply(rpc)
+
+        name = saneproto.code_name(rpc)
+        self.result['latency'].setdefault(name, []).append((time.time() - started) * 1000.0)
+
+        status = reply.get('status')
+        if status not in (None, saneproto.SANE_STATUS_GOOD):
+            key = '%s/%s' % (name, saneproto.status_name(status))
+            self.result['statuses'][key] = self.result['statuses'].get(key, 0) + 1
+            return
+
+        if rpc == saneproto.SANE_NET_OPEN and step.get('captured_handle') is not None:
+            self.handles[step['captured_handle']] = reply['handle']
+        elif rpc == saneproto.SANE_NET_START and reply['port']:
+            self.receive_image(reply['port'])
+
+    def authorize(self, wire, resource):
+        # saned asks for "backend$MD5$salt" when it wants a hashed password
+        backend, _, salt = resource.partition('$MD5$')
+        username, password = None, None
+        for captured, (captured_username, captured_password) in self.script.credentials.items():
+            # a captured hash only matches the salt it was made for
+            if captured.partition('$MD5$')[0] == backend and (
+                    captured == resource or not captured_password.startswith('$MD5$')):
+                username, password = captured_username, captured_password
+        if username is None:
+            username, password = self.options.user, self.options.password
+        if username is None:
+            raise ReplayError('no credentials to authorize %s' % resource)
+        if salt and not password.startswith('$MD5$'):
+            password = '$MD5$' + hashlib.md5((salt + password).encode('utf-8')).hexdigest()
+        wire.send(saneproto.pack_request(saneproto.SANE_NET_AUTHORIZE, self.script.version,
+                                         resource=resource, username=username,
+                                         password=password))
+        wire.read_reply(saneproto.SANE_NET_AUTHORIZE)
+
+    def receive_image(self, port):
+        started = time.time()
+        sock = self.connect(port)
+        try:
+            data = saneproto.Wire(sock)
+            received = 0
+            while True:
+                record, status = data.read_record()
+                if record is None:
+                    break
+                received += len(record)
+        finally:
+            sock.close()
+        self.result['transfers'].append((received, time.time() - started, status))
+
+
+def worker(jobs, results, options, replay_start):
+    while True:
+        try:
+            script, offset = jobs.get_nowait()
+        except queue.Empty:
+            return
+        if options.pacing:
+            delay = replay_start + offset / options.speed - time.time()
+            if delay > 0:
+                time.sleep(delay)
+        results.put(Session(script, options).run())
+
+
+def merge_result(total, partial):
+    total['sessions'] += partial['sessions']
+    total['failed'].extend(partial['failed'])
+    total['transfers'].extend(partial['transfers'])
+    for name, values in partial['latency'].items():
+        total['latency'].setdefault(name, []).extend(values)
+    for key, value in partial['statuses'].items():
+        total['statuses'][key] = total['statuses'].get(key, 0) + value
+
+
+def percentile(values, fraction):
+    return values[min(len(values) - 1, int(len(values) * fraction))]
+
+
+def print_report(total, elapsed, out=sys.stdout):
+    print('Sessions replayed: %d in %.3fs, %d failed' % (
+        total['sessions'], elapsed, len(total['failed'])), file=out)
+    for stream, error in total['failed']:
+        print('  failed: stream %s: %s' % (stream, error), file=out)
+
+    print('', file=out)
+    print('Response time per RPC (ms)', file=out)
+    print('  %-32s%8s%10s%10s%10s%10s%10s' % ('RPC', 'Count', 'Avg', 'Min', 'Median', '95%', 'Max'), file=out)
+    for name in sorted(total['latency']):
+        values = sorted(total['latency'][name])
+        print('  %-32s%8d%10.2f%10.2f%10.2f%10.2f%10.2f' % (
+            name, len(values), sum(values) / len(values), values[0],
+            percentile(values, 0.5), percentile(values, 0.95), values[-1]), file=out)
+
+    if total['statuses']:
+        print('', file=out)
+        print('Statuses other than SANE_STATUS_GOOD', file=out)
+        for key in sorted(total['statuses']):
+            print('  %-64s%8d' % (key, total['statuses'][key]), file=out)
+
+    transfers = total['transfers']
+    if transfers:
+        received = sum(transfer[0] for transfer in transfers)
+        seconds = sum(transfer[1] for transfer in transfers)
+        rates = sorted(transfer[0] / transfer[1] / 1024.0 for transfer in transfers if transfer[1] > 0)
+        print('', file=out)
+        print('Image data', file=out)
+        print('  %d transfers, %d bytes, %.2f KiB/s per transfer, %.2f KiB/s overall' % (
+            len(transfers), received, received / seconds / 1024.0 if seconds else 0.0,
+            received / elapsed / 1024.0 if elapsed else 0.0), file=out)
+        if rates:
+            print('  per transfer KiB/s: min %.2f, median %.2f, max %.2f' % (
+                rates[0], percentile(rates, 0.5), rates[-1]), file=out)
+        failed = sum(1 for transfer in transfers if transfer[2] not in (saneproto.SANE_STATUS_GOOD,
+                                                                         saneproto.SANE_STATUS_EOF))
+        if failed:
+            print('  %d transfers ended with an error status' % failed, file=out)
+
+
+def print_scripts(scripts, out=sys.stdout):
+    for script in scripts:
+        print('stream %s at %.3fs: %d requests' % (script.stream, script.start, len(script.steps)), file=out)
+        for step in script.steps:
+            print('  +%.3fs %s' % (step['think'], saneproto.code_name(step['rpc'])), file=out)
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options] CAPTURE HOST[:PORT]')
+    parser.add_option('-c', '--concurrency', type='int', default=4,
+                      help='sessions replayed at the same time [default: %default]')
+    parser.add_option('-r', '--repeat', type='int', default=1,
+                      help='replay the sessions of the capture this often [default: %default]')
+    parser.add_option('-s', '--speed', type='float', default=1.0,
+                      help='divide the captured timing by this factor [default: %default]')
+    parser.add_option('--no-pacing', dest='pacing', action='store_false', default=True,
+                      help='start every session as soon as a slot is free')
+    parser.add_option('--no-think', dest='think', action='store_false', default=True,
+                      help='send each request right after the previous reply')
+    parser.add_option('--stream', action='append', metavar='N',
+                      help='only replay this TCP stream, may be repeated')
+    parser.add_option('--user', help='user name for authorization not seen in the capture')
+    parser.add_option('--password', default='', help='password for --user')
+    parser.add_option('--timeout', type='float', default=30.0,
+                      help='socket timeout in seconds [default: %default]')
+    parser.add_option('--tshark', default='tshark',
+                      help='tshark binary to use [default: %default]')
+    parser.add_option('-n', '--dry-run', action='store_true', default=False,
+                      help='only print the sessions found in the capture')
+    options, args = parser.parse_args()
+    if len(args) != 2 and not (options.dry_run and len(args) == 1):
+        parser.error('expected a capture file and the saned to replay against')
+    if options.speed <= 0:
+        parser.error('--speed must be positive')
+
+    try:
+        scripts = read_scripts(options.tshark, args[0])
+    except ReplayError as error:
+        print('sane-replay.py: %s' % error, file=sys.stderr)
+        return 1
+    if options.stream:
+        scripts = [script for script in scripts if script.stream in options.stream]
+
+    if options.dry_run:
+        print_scripts(scripts)
+        return 0
+    if not scripts:
+        print('sane-replay.py: no SANE sessions found in %s' % args[0], file=sys.stderr)
+        return 1
+
+    host, _, port = args[1].rpartition(':')
+    if not host or ']' in port:
+        host, port = args[1], saneproto.TCP_PORT_SANE
+    options.host = host.strip('[]')
+    options.port = int(port)
+
+    jobs = queue.Queue()
+    results = queue.Queue()
+    # repetitions follow each other like the capture was recorded several times in a row
+    duration = max([0.0] + [step['reply_time'] or step['time'] for script in scripts for step in script.steps])
+    for repetition in range(options.repeat):
+        for script in scripts:
+            jobs.put((script, repetition * duration + script.start))
+
+    replay_start = time.time()
+    threads = [threading.Thread(target=worker, args=(jobs, results, options, replay_start))
+               for _ in range(max(1, options.concurrency))]
+    for thread in threads:
+        thread.daemon = True
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.time() - replay_start
+
+    total = new_result()
+    while not results.empty():
+        merge_result(total, results.get())
+    print_report(total, elapsed)
+
+    return 1 if total['failed'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,536 @@
+# saneproto.py
+# Constants, wire encoding and dissection of the SANE network protocol shared by the SANE tools
+#
+# Copyright (C) 2013, Marc Hoersken, <info@marc-hoersken.de>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+import struct
+import subprocess
+import tempfile
+from xml.etree import ElementTree
+
+TCP_PORT_SANE = 6566
+
+SANE_NET_PROTOCOL_VERSION = 3
+
+SANE_NET_INIT = 0
+SANE_NET_GET_DEVICES = 1
+SANE_NET_OPEN = 2
+SANE_NET_CLOSE = 3
+SANE_NET_GET_OPTION_DESCRIPTORS = 4
+SANE_NET_CONTROL_OPTION = 5
+SANE_NET_GET_PARAMETERS = 6
+SANE_NET_START = 7
+SANE_NET_CANCEL = 8
+SANE_NET_AUTHORIZE = 9
+SANE_NET_EXIT = 10
+
+SANE_STATUS_GOOD = 0
+SANE_STATUS_UNSUPPORTED = 1
+SANE_STATUS_CANCELLED = 2
+SANE_STATUS_DEVICE_BUSY = 3
+SANE_STATUS_INVAL = 4
+SANE_STATUS_EOF = 5
+SANE_STATUS_JAMMED = 6
+SANE_STATUS_NO_DOCS = 7
+SANE_STATUS_COVER_OPEN = 8
+SANE_STATUS_IO_ERROR = 9
+SANE_STATUS_NO_MEM = 10
+SANE_STATUS_ACCESS_DENIED = 11
+
+SANE_TYPE_BOOL = 0
+SANE_TYPE_INT = 1
+SANE_TYPE_FIXED = 2
+SANE_TYPE_STRING = 3
+SANE_TYPE_BUTTON = 4
+SANE_TYPE_GROUP = 5
+
+SANE_CONSTRAINT_NONE = 0
+SANE_CONSTRAINT_RANGE = 1
+SANE_CONSTRAINT_WORD_LIST = 2
+SANE_CONSTRAINT_STRING_LIST = 3
+
+SANE_ACTION_GET_VALUE = 0
+SANE_ACTION_SET_VALUE = 1
+SANE_ACTION_SET_AUTO = 2
+
+SANE_INFO_INEXACT = 0x1
+SANE_INFO_RELOAD_OPTIONS = 0x2
+SANE_INFO_RELOAD_PARAMS = 0x4
+
+SANE_FRAME_GRAY = 0
+SANE_FRAME_RGB = 1
+SANE_FRAME_RED = 2
+SANE_FRAME_GREEN = 3
+SANE_FRAME_BLUE = 4
+
+SANE_CAP_SOFT_SELECT = 0x01
+SANE_CAP_HARD_SELECT = 0x02
+SANE_CAP_SOFT_DETECT = 0x04
+SANE_CAP_EMULATED = 0x08
+SANE_CAP_AUTOMATIC = 0x10
+SANE_CAP_INACTIVE = 0x20
+SANE_CAP_ADVANCED = 0x40
+
+SANE_UNIT_NONE = 0
+SANE_UNIT_PIXEL = 1
+SANE_UNIT_BIT = 2
+SANE_UNIT_MM = 3
+SANE_UNIT_DPI = 4
+SANE_UNIT_PERCENT = 5
+SANE_UNIT_MICROSECOND = 6
+
+SANE_DATA_END_OF_RECORDS = 0xffffffff
+
+SANE_DATA_UNKNOWN = 0
+SANE_DATA_COMPLETE = 1
+SANE_DATA_SHORT = 2
+SANE_DATA_OVERLONG = 3
+
+CODE_NAMES = {
+    SANE_NET_INIT: 'SANE_NET_INIT',
+    SANE_NET_GET_DEVICES: 'SANE_NET_GET_DEVICES',
+    SANE_NET_OPEN: 'SANE_NET_OPEN',
+    SANE_NET_CLOSE: 'SANE_NET_CLOSE',
+    SANE_NET_GET_OPTION_DESCRIPTORS: 'SANE_NET_GET_OPTION_DESCRIPTORS',
+    SANE_NET_CONTROL_OPTION: 'SANE_NET_CONTROL_OPTION',
+    SANE_NET_GET_PARAMETERS: 'SANE_NET_GET_PARAMETERS',
+    SANE_NET_START: 'SANE_NET_START',
+    SANE_NET_CANCEL: 'SANE_NET_CANCEL',
+    SANE_NET_AUTHORIZE: 'SANE_NET_AUTHORIZE',
+    SANE_NET_EXIT: 'SANE_NET_EXIT',
+}
+
+STATUS_NAMES = {
+    SANE_STATUS_GOOD: 'SANE_STATUS_GOOD',
+    SANE_STATUS_UNSUPPORTED: 'SANE_STATUS_UNSUPPORTED',
+    SANE_STATUS_CANCELLED: 'SANE_STATUS_CANCELLED',
+    SANE_STATUS_DEVICE_BUSY: 'SANE_STATUS_DEVICE_BUSY',
+    SANE_STATUS_INVAL: 'SANE_STATUS_INVAL',
+    SANE_STATUS_EOF: 'SANE_STATUS_EOF',
+    SANE_STATUS_JAMMED: 'SANE_STATUS_JAMMED',
+    SANE_STATUS_NO_DOCS: 'SANE_STATUS_NO_DOCS',
+    SANE_STATUS_COVER_OPEN: 'SANE_STATUS_COVER_OPEN',
+    SANE_STATUS_IO_ERROR: 'SANE_STATUS_IO_ERROR',
+    SANE_STATUS_NO_MEM: 'SANE_STATUS_NO_MEM',
+    SANE_STATUS_ACCESS_DENIED: 'SANE_STATUS_ACCESS_DENIED',
+}
+
+COMPLETENESS_NAMES = {
+    SANE_DATA_UNKNOWN: 'Unknown',
+    SANE_DATA_COMPLETE: 'Complete',
+    SANE_DATA_SHORT: 'Short',
+    SANE_DATA_OVERLONG: 'Over-long',
+}
+
+
+def code_name(code):
+    return CODE_NAMES.get(code, 'RPC Code: 0x%08x' % code)
+
+
+def status_name(status):
+    return STATUS_NAMES.get(status, 'Status: 0x%08x' % status)
+
+
+
+def version_code(major, minor, build):
+    return (major & 0xff) << 24 | (minor & 0xff) << 16 | (build & 0xffff)
+
+
+def fix(value):
+    """SANE_FIX(), as an unsigned word."""
+    return int(round(value * (1 << 16))) & 0xffffffff
+
+
+def unfix(word):
+    """SANE_UNFIX() of an unsigned word."""
+    if word & 0x80000000:
+        word -= 1 << 32
+    return float(word) / (1 << 16)
+
+
+# Wire encoding, see sanei_wire.c. Words are big-endian, strings carry their
+# length including the terminating NUL and NULL strings have a length of 0.
+
+WORD = struct.Struct('>I')
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def value_element_size(value_type):
+    """Size of the elements of an option value, see sanei_w_option_value()."""
+    if value_type in (SANE_TYPE_BOOL, SANE_TYPE_INT, SANE_TYPE_FIXED):
+        return 4
+    if value_type == SANE_TYPE_STRING:
+        return 1
+    return 0
+
+
+def has_value(value_type):
+    """Option values of unknown types are not encoded at all."""
+    return value_type <= SANE_TYPE_GROUP
+
+
+def pack_word(value):
+    return WORD.pack(value & 0xffffffff)
+
+
+def pack_string(value):
+    if value is None:
+        return pack_word(0)
+    if not isinstance(value, bytes):
+        value = value.encode('utf-8')
+    return pack_word(len(value) + 1) + value + b'\0'
+
+
+def pack_value(value_type, data):
+    if not has_value(value_type):
+        return b''
+    size = value_element_size(value_type)
+    if not size:
+        return pack_word(0)
+    return pack_word(len(data) // size) + data
+
+
+def pack_request(rpc, version=SANE_NET_PROTOCOL_VERSION, **fields):
+    """Encode a request, taking its arguments from the keyword arguments."""
+    parts = [pack_word(rpc)]
+    if rpc == SANE_NET_INIT:
+        parts.append(pack_word(fields.get('version_code', version_code(1, 0, version))))
+        parts.append(pack_string(fields.get('user_name')))
+    elif rpc == SANE_NET_OPEN:
+        parts.append(pack_string(fields.get('device')))
+    elif rpc == SANE_NET_CONTROL_OPTION:
+        action = fields.get('action', SANE_ACTION_GET_VALUE)
+        parts.append(pack_word(fields['handle']))
+        parts.append(pack_word(fields['option']))
+        parts.append(pack_word(action))
+        # up to protocol version 2 the value was sent along with SANE_ACTION_SET_AUTO
+        if version < 3 or action != SANE_ACTION_SET_AUTO:
+            value_type = fields.get('value_type', SANE_TYPE_INT)
+            value = fields.get('value', b'')
+            parts.append(pack_word(value_type))
+            parts.append(pack_word(fields.get('value_size', len(value))))
+            parts.append(pack_value(value_type, value))
+    elif rpc == SANE_NET_AUTHORIZE:
+        parts.append(pack_string(fields.get('resource')))
+        parts.append(pack_string(fields.get('username')))
+        parts.append(pack_string(fields.get('password')))
+    elif rpc in (SANE_NET_CLOSE, SANE_NET_GET_OPTION_DESCRIPTORS, SANE_NET_GET_PARAMETERS,
+                 SANE_NET_START, SANE_NET_CANCEL):
+        parts.append(pack_word(fields['handle']))
+    return b''.join(parts)
+
+
+def pack_option_descriptor(option):
+    parts = [
+        pack_string(option.get('name')),
+        pack_string(option.get('title')),
+        pack_string(option.get('desc')),
+        pack_word(option['type']),
+        pack_word(option.get('unit', 0)),
+        pack_word(option['size']),
+        pack_word(option.get('cap', 0)),
+        pack_word(option.get('constraint_type', SANE_CONSTRAINT_NONE)),
+    ]
+    constraint = option.get('constraint')
+    if option.get('constraint_type') == SANE_CONSTRAINT_RANGE:
+        if constraint is None:
+            parts.append(pack_word(1))
+        else:
+            parts.append(pack_word(0))
+            parts.extend(pack_word(word) for word in constraint)
+    elif option.get('constraint_type') == SANE_CONSTRAINT_WORD_LIST:
+        parts.append(pack_word(len(constraint)))
+        parts.extend(pack_word(word) for word in constraint)
+    elif option.get('constraint_type') == SANE_CONSTRAINT_STRING_LIST:
+        parts.append(pack_word(len(constraint)))
+        parts.extend(pack_string(string) for string in constraint)
+    return b''.join(parts)
+
+
+def pack_reply(rpc, **fields):
+    """Encode the reply to a request, taking its fields from the keyword arguments."""
+    status = pack_word(fields.get('status', SANE_STATUS_GOOD))
+    resource = pack_string(fields.get('resource'))
+    if rpc == SANE_NET_INIT:
+        return status + pack_word(fields.get('version_code', version_code(1, 0, SANE_NET_PROTOCOL_VERSION)))
+    if rpc == SANE_NET_GET_DEVICES:
+        devices = fields.get('devices', ())
+        parts = [status, pack_word(len(devices))]
+        for device in devices:
+            if device is None:
+                parts.append(pack_word(1))
+            else:
+                parts.append(pack_word(0))
+                parts.extend(pack_string(string) for string in device)
+        return b''.join(parts)
+    if rpc == SANE_NET_OPEN:
+        return status + pack_word(fields.get('handle', 0)) + resource
+    if rpc == SANE_NET_GET_OPTION_DESCRIPTORS:
+        options = fields.get('options', ())
+        parts = [pack_word(len(options))]
+        for option in options:
+            if option is None:
+                parts.append(pack_word(1))
+            else:
+                parts.append(pack_word(0))
+                parts.append(pack_option_descriptor(option))
+        return b''.join(parts)
+    if rpc == SANE_NET_CONTROL_OPTION:
+        value_type = fields.get('value_type', SANE_TYPE_INT)
+        value = fields.get('value', b'')
+        return b''.join((status, pack_word(fields.get('info', 0)), pack_word(value_type),
+                         pack_word(fields.get('value_size', len(value))),
+                         pack_value(value_type, value), resource))
+    if rpc == SANE_NET_GET_PARAMETERS:
+        parameters = fields.get('parameters', (0,) * 6)
+        return status + b''.join(pack_word(word) for word in parameters)
+    if rpc == SANE_NET_START:
+        return b''.join((status, pack_word(fields.get('port', 0)),
+                         pack_word(fields.get('byte_order', 0x1234)), resource))
+    return pack_word(fields.get('dummy', 0))
+
+
+def pack_record(data):
+    """Encode an image data record."""
+    return pack_word(len(data)) + data
+
+
+def pack_end_of_records(status):
+    return pack_word(SANE_DATA_END_OF_RECORDS) + bytes(bytearray((status,)))
+
+
+def has_reply(rpc):
+    """saned closes the connection on SANE_NET_EXIT instead of replying."""
+    return rpc != SANE_NET_EXIT
+
+
+class Wire(object):
+    """Reads SANE requests and replies from a connected socket."""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.buffer = b''
+
+    def send(self, data):
+        self.sock.sendall(data)
+
+    def read(self, size):
+        while len(self.buffer) < size:
+            chunk = self.sock.recv(max(size - len(self.buffer), 65536))
+            if not chunk:
+                raise ProtocolError('connection closed by peer')
+            self.buffer += chunk
+        data, self.buffer = self.buffer[:size], self.buffer[size:]
+        return data
+
+    def read_word(self):
+        return WORD.unpack(self.read(4))[0]
+
+    def read_string(self):
+        size = self.read_word()
+        if not size:
+            return None
+        return self.read(size).rstrip(b'\0').decode('utf-8', 'replace')
+
+    def read_value(self, value_type):
+        if not has_value(value_type):
+            return b''
+        return self.read(self.read_word() * value_element_size(value_type))
+
+    def read_option_descriptor(self):
+        option = {
+            'name': self.read_string(),
+            'title': self.read_string(),
+            'desc': self.read_string(),
+            'type': self.read_word(),
+            'unit': self.read_word(),
+            'size': self.read_word(),
+            'cap': self.read_word(),
+            'constraint_type': self.read_word(),
+            'constraint': None,
+        }
+        if option['constraint_type'] == SANE_CONSTRAINT_RANGE:
+            if not self.read_word():
+                option['constraint'] = (self.read_word(), self.read_word(), self.read_word())
+        elif option['constraint_type'] == SANE_CONSTRAINT_WORD_LIST:
+            option['constraint'] = [self.read_word() for _ in range(self.read_word())]
+        elif option['constraint_type'] == SANE_CONSTRAINT_STRING_LIST:
+            option['constraint'] = [self.read_string() for _ in range(self.read_word())]
+        return option
+
+    def read_request(self, version=SANE_NET_PROTOCOL_VERSION):
+        """Read a request, as its RPC code and a dictionary of its fields."""
+        rpc = self.read_word()
+        request = {}
+        if rpc == SANE_NET_INIT:
+            request['version_code'] = self.read_word()
+            request['user_name'] = self.read_string()
+        elif rpc == SANE_NET_OPEN:
+            request['device'] = self.read_string()
+        elif rpc == SANE_NET_CONTROL_OPTION:
+            request['handle'] = self.read_word()
+            request['option'] = self.read_word()
+            request['action'] = self.read_word()
+            # up to protocol version 2 the value was sent along with SANE_ACTION_SET_AUTO
+            if version < 3 or request['action'] != SANE_ACTION_SET_AUTO:
+                request['value_type'] = self.read_word()
+                request['value_size'] = self.read_word()
+                request['value'] = self.read_value(request['value_type'])
+        elif rpc == SANE_NET_AUTHORIZE:
+            request['resource'] = self.read_string()
+            request['username'] = self.read_string()
+            request['password'] = self.read_string()
+        elif rpc in (SANE_NET_CLOSE, SANE_NET_GET_OPTION_DESCRIPTORS, SANE_NET_GET_PARAMETERS,
+                     SANE_NET_START, SANE_NET_CANCEL):
+            request['handle'] = self.read_word()
+        elif rpc not in (SANE_NET_GET_DEVICES, SANE_NET_EXIT):
+            raise ProtocolError('unknown request %s' % code_name(rpc))
+        return rpc, request
+
+    def read_reply(self, rpc):
+        """Read the reply to a request, as a dictionary of its fields."""
+        reply = {}
+        if rpc == SANE_NET_INIT:
+            reply['status'] = self.read_word()
+            reply['version_code'] = self.read_word()
+        elif rpc == SANE_NET_GET_DEVICES:
+            reply['status'] = self.read_word()
+            devices = []
+            for _ in range(self.read_word()):
+                if self.read_word():
+                    continue
+                devices.append((self.read_string(), self.read_string(),
+                                self.read_string(), self.read_string()))
+            reply['devices'] = devices
+        elif rpc == SANE_NET_OPEN:
+            reply['status'] = self.read_word()
+            reply['handle'] = self.read_word()
+            reply['resource'] = self.read_string()
+        elif rpc == SANE_NET_GET_OPTION_DESCRIPTORS:
+            options = []
+            for _ in range(self.read_word()):
+                options.append(None if self.read_word() else self.read_option_descriptor())
+            reply['options'] = options
+        elif rpc == SANE_NET_CONTROL_OPTION:
+            reply['status'] = self.read_word()
+            reply['info'] = self.read_word()
+            reply['value_type'] = self.read_word()
+            reply['value_size'] = self.read_word()
+            reply['value'] = self.read_value(reply['value_type'])
+            reply['resource'] = self.read_string()
+        elif rpc == SANE_NET_GET_PARAMETERS:
+            reply['status'] = self.read_word()
+            reply['parameters'] = tuple(self.read_word() for _ in range(6))
+        elif rpc == SANE_NET_START:
+            reply['status'] = self.read_word()
+            reply['port'] = self.read_word()
+            reply['byte_order'] = self.read_word()
+            reply['resource'] = self.read_string()
+        elif rpc in (SANE_NET_CLOSE, SANE_NET_CANCEL, SANE_NET_AUTHORIZE):
+            reply['dummy'] = self.read_word()
+        else:
+            raise ProtocolError('no reply known for %s' % code_name(rpc))
+        return reply
+
+    def read_record(self):
+        """Read an image data record, returns the data and None, or None and
+        the status at the end of data."""
+        size = self.read_word()
+        if size == SANE_DATA_END_OF_RECORDS:
+            return None, ord(self.read(1))
+        return self.read(size), None
+
+
+# Dissected captures, see the SANE plugin
+
+class TsharkError(Exception):
+    pass
+
+
+def tshark_pdus(tshark, capture, display_filter, frame_fields, pdu_fields):
+    """Run tshark over a capture and yield one dictionary per SANE PDU.
+
+    The frame fields are taken once per frame and shared by its PDUs, the
+    PDU fields are taken from the protocol tree of each PDU on its own, so
+    every value goes to the PDU that carries it. Fields a frame or PDU
+    does not carry are empty, fields it carries more than once keep their
+    first value. Raises TsharkError once the rows are read if tshark could
+    not be run or failed.
+    """
+    frame_fields = frozenset(frame_fields)
+    pdu_fields = frozenset(pdu_fields)
+    command = [tshark, '-n', '-r', capture, '-Y', display_filter,
+               '-o', 'tcp.desegment_tcp_streams:TRUE', '-T', 'pdml']
+
+    # a pipe tshark blocks on while its output is read would stall both
+    stderr = tempfile.TemporaryFile()
+    try:
+        try:
+            process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=stderr)
+        except OSError as error:
+            raise TsharkError('cannot run %s: %s' % (tshark, error))
+
+        try:
+            root = None
+            for event, element in ElementTree.iterparse(process.stdout, ('start', 'end')):
+                if root is None:
+                    root = element
+                if event != 'end' or element.tag != 'packet':
+                    continue
+
+                frame = {}
+                pdus = []
+                for proto in element.findall('proto'):
+                    if proto.get('name') == 'sane':
+                        pdus.append(tshark_values(proto, pdu_fields))
+                    else:
+                        for field, value in tshark_values(proto, frame_fields).items():
+                            frame.setdefault(field, value)
+                root.clear()
+
+                for values in pdus:
+                    pdu = dict.fromkeys(frame_fields | pdu_fields, '')
+                    pdu.update(frame)
+                    pdu.update(values)
+                    yield pdu
+        except ElementTree.ParseError as error:
+            unreadable = error
+            if process.poll() is None:
+                process.kill()
+        else:
+            unreadable = None
+
+        if process.wait() != 0 and not (unreadable and process.returncode < 0):
+            stderr.seek(0)
+            raise TsharkError('%s failed: %s' % (tshark, stderr.read().decode('utf-8', 'replace').strip()))
+        if unreadable:
+            raise TsharkError('%s: unreadable output: %s' % (tshark, unreadable))
+    finally:
+        stderr.close()
+
+
+def tshark_values(proto, fields):
+    """First value of each of the fields a protocol of a PDML packet carries."""
+    values = {}
+    for element in proto.iter('field'):
+        name = element.get('name')
+        if name in fields and name not in values:
+            values[name] = element.get('show', '')
+    return values